@@ -0,0 +1,267 @@
+/*
+   Independent MT19937-64 streams for parallel replicates.
+
+   MT.h keeps a single global state (mt[], mti), so only one sequence can be
+   drawn at a time. The same generator is kept here in a context (MT64), so
+   that every worker can draw from its own copy.
+
+   Streams are made non-overlapping by the jump-ahead of
+     H. Haramoto, M. Matsumoto, T. Nishimura, F. Panneton, P. L'Ecuyer,
+     ``Efficient jump ahead for F2-linear random number generators''
+     INFORMS Journal on Computing 20 (2008) 385--390.
+   Stream k is the seeded state advanced by k*2^MT_JUMP_LOG2 raw words.
+
+   The jump polynomial x^(2^MT_JUMP_LOG2) mod phi(x) is computed once, at
+   the first jump: phi, the characteristic polynomial of degree 19937, is
+   recovered from the output bits by Berlekamp-Massey.
+
+   Include this header instead of MT.h.
+*/
+
+#ifndef MTSTREAM_H
+#define MTSTREAM_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "MT.h"
+
+#define MT_DEGREE 19937 // degree of the characteristic polynomial
+#define MT_POLY_WORDS ((MT_DEGREE + 64) / 64) // words of a polynomial of degree <= MT_DEGREE
+#ifndef MT_JUMP_LOG2
+#define MT_JUMP_LOG2 64 // distance between streams is 2^64 raw words
+#endif
+
+typedef struct mt64 {
+	unsigned long long mt[NN];
+	int mti; // mti==NN means the next draw regenerates the whole array
+} MT64;
+
+/* the jump polynomial, computed by mt64_jump_init() */
+static unsigned long long mtJumpPoly[MT_POLY_WORDS];
+static int mtJumpReady = 0;
+
+/* initializes a context with a seed, same sequence as init_genrand64() */
+void mt64_init(MT64 *g, unsigned long long seed)
+{
+	int i;
+
+	g->mt[0] = seed;
+	for(i=1; i<NN; i++)
+		g->mt[i] = (6364136223846793005ULL * (g->mt[i-1] ^ (g->mt[i-1] >> 62)) + i);
+	g->mti = NN;
+}
+
+/* generates a random number on [0, 2^64-1]-interval, same as genrand64_int64() */
+static inline unsigned long long mt64_int64(MT64 *g)
+{
+	int i;
+	unsigned long long x;
+	static const unsigned long long mag01[2]={0ULL, MATRIX_A};
+
+	if(g->mti >= NN){ // generate NN words at one time
+		unsigned long long *mt = g->mt;
+
+		for(i=0; i<NN-MM; i++){
+			x = (mt[i]&UM)|(mt[i+1]&LM);
+			mt[i] = mt[i+MM] ^ (x>>1) ^ mag01[(int)(x&1ULL)];
+		}
+		for(; i<NN-1; i++){
+			x = (mt[i]&UM)|(mt[i+1]&LM);
+			mt[i] = mt[i+(MM-NN)] ^ (x>>1) ^ mag01[(int)(x&1ULL)];
+		}
+		x = (mt[NN-1]&UM)|(mt[0]&LM);
+		mt[NN-1] = mt[MM-1] ^ (x>>1) ^ mag01[(int)(x&1ULL)];
+
+		g->mti = 0;
+	}
+
+	x = g->mt[g->mti++];
+
+	x ^= (x >> 29) & 0x5555555555555555ULL;
+	x ^= (x << 17) & 0x71D67FFFEDA60000ULL;
+	x ^= (x << 37) & 0xFFF7EEE000000000ULL;
+	x ^= (x >> 43);
+
+	return x;
+}
+
+/* generates a random number on (0,1)-real-interval, same as genrand64_real3() */
+static inline double mt64_real3(MT64 *g)
+{
+	return ((mt64_int64(g) >> 12) + 0.5) * (1.0/4503599627370496.0);
+}
+
+
+/* ---- polynomials over GF(2), bit j of word j/64 is the coefficient of x^j ---- */
+
+static int polyBit(const unsigned long long p[], int j)
+{
+	return (int)((p[j >> 6] >> (j & 63)) & 1ULL);
+}
+
+/* p ^= q * x^shift, q has qWords words */
+static void polyXorShifted(unsigned long long p[], const unsigned long long q[], int qWords, int shift)
+{
+	int w, ws = shift >> 6, bs = shift & 63;
+
+	for(w=0; w<qWords; w++){
+		if(q[w] == 0) continue;
+		p[w + ws] ^= q[w] << bs;
+		if(bs) p[w + ws + 1] ^= q[w] >> (64 - bs);
+	}
+}
+
+/* reduces p (degree < 2*MT_DEGREE) modulo phi (degree MT_DEGREE) in place */
+static void polyMod(unsigned long long p[], const unsigned long long phi[])
+{
+	int j;
+
+	for(j=2*MT_DEGREE-2; j>=MT_DEGREE; j--)
+		if(polyBit(p, j)) polyXorShifted(p, phi, MT_POLY_WORDS, j - MT_DEGREE);
+}
+
+/* r = p^2 mod phi, r and p may be the same array */
+static void polySquareMod(unsigned long long r[], const unsigned long long p[], const unsigned long long phi[])
+{
+	int w, b;
+	unsigned long long sq[2*MT_POLY_WORDS + 1];
+
+	memset(sq, 0, sizeof(sq));
+	// squaring over GF(2) only spreads the bits: (sum a_j x^j)^2 = sum a_j x^2j
+	for(w=0; w<MT_POLY_WORDS; w++){
+		for(b=0; b<64; b++){
+			if((p[w] >> b) & 1ULL){
+				int j = 2*(64*w + b);
+				sq[j >> 6] |= 1ULL << (j & 63);
+			}
+		}
+	}
+	polyMod(sq, phi);
+	memcpy(r, sq, MT_POLY_WORDS * sizeof(unsigned long long));
+}
+
+/* parity of sum_{i=0..len-1} c_i r_{off+i}, r and c are bit arrays */
+static int bitDot(const unsigned long long c[], int len, const unsigned long long r[], int off)
+{
+	int w, words = (len + 63) >> 6, ws = off >> 6, bs = off & 63;
+	unsigned long long acc = 0, x;
+
+	for(w=0; w<words; w++){
+		x = r[ws + w] >> bs;
+		if(bs) x |= r[ws + w + 1] << (64 - bs);
+		acc ^= x & c[w];
+	}
+	return __builtin_parityll(acc);
+}
+
+/*
+   Recovers the characteristic polynomial phi of MT19937-64 with
+   Berlekamp-Massey on the lowest output bit and computes
+   mtJumpPoly = x^(2^MT_JUMP_LOG2) mod phi.
+*/
+void mt64_jump_init()
+{
+	int n, i, L = 0, m = 1;
+	const int len = 2 * NN * 64; // twice the state size is enough for BM
+	const int words = len / 64 + 2;
+	unsigned long long *r, *C, *B, *T, *phi;
+	MT64 g;
+
+	if(mtJumpReady) return;
+
+	r = calloc(words, sizeof(unsigned long long)); // the output bits in reversed order
+	C = calloc(words, sizeof(unsigned long long));
+	B = calloc(words, sizeof(unsigned long long));
+	T = calloc(words, sizeof(unsigned long long));
+	phi = calloc(MT_POLY_WORDS + 1, sizeof(unsigned long long));
+
+	mt64_init(&g, 5489ULL);
+	for(n=0; n<len; n++){
+		if(mt64_int64(&g) & 1ULL){
+			i = len - 1 - n;
+			r[i >> 6] |= 1ULL << (i & 63);
+		}
+	}
+
+	// C(x) is the connection polynomial, s_n = sum_{i=1..L} c_i s_{n-i}
+	C[0] = B[0] = 1ULL;
+	for(n=0; n<len; n++){
+		if(bitDot(C, L + 1, r, len - 1 - n) == 0){ // no discrepancy
+			m++;
+		} else if(2*L <= n){
+			memcpy(T, C, words * sizeof(unsigned long long));
+			polyXorShifted(C, B, words - (m >> 6) - 1, m);
+			L = n + 1 - L;
+			memcpy(B, T, words * sizeof(unsigned long long));
+			m = 1;
+		} else {
+			polyXorShifted(C, B, words - (m >> 6) - 1, m);
+			m++;
+		}
+	}
+	if(L != MT_DEGREE){
+		fprintf(stderr, "mt64_jump_init: unexpected linear complexity %d\n", L);
+		exit(1);
+	}
+
+	// phi(x) = x^L C(1/x)
+	for(i=0; i<=L; i++)
+		if(polyBit(C, L - i)) phi[i >> 6] |= 1ULL << (i & 63);
+
+	// x^(2^14) has degree below MT_DEGREE, square the rest of the way modulo phi
+	memset(mtJumpPoly, 0, sizeof(mtJumpPoly));
+	mtJumpPoly[(1 << 14) >> 6] = 1ULL;
+	for(i=14; i<MT_JUMP_LOG2; i++) polySquareMod(mtJumpPoly, mtJumpPoly, phi);
+
+	free(r); free(C); free(B); free(T); free(phi);
+	mtJumpReady = 1;
+}
+
+/*
+   Advances g by the polynomial q, i.e. by q(A) where A is one raw-word step.
+   g must be freshly seeded or jumped (mti == NN): its array then holds the
+   last NN raw words, which is the window that q(A) acts on.
+*/
+void mt64_jump_poly(MT64 *g, const unsigned long long q[])
+{
+	int j, k, i = 0;
+	unsigned long long x, cur[NN], acc[NN];
+	static const unsigned long long mag01[2]={0ULL, MATRIX_A};
+
+	memcpy(cur, g->mt, sizeof(cur));
+	memset(acc, 0, sizeof(acc));
+	for(j=0; j<MT_DEGREE; j++){
+		if(polyBit(q, j)){ // acc += A^j g, the window of cur starts at i
+			for(k=0; k<NN-i; k++) acc[k] ^= cur[i + k];
+			for(; k<NN; k++) acc[k] ^= cur[i + k - NN];
+		}
+		// one raw-word step of the circular window
+		x = (cur[i]&UM)|(cur[(i+1)%NN]&LM);
+		cur[i] = cur[(i+MM)%NN] ^ (x>>1) ^ mag01[(int)(x&1ULL)];
+		i = (i+1)%NN;
+	}
+	memcpy(g->mt, acc, sizeof(acc));
+	g->mti = NN;
+}
+
+/* advances g by 2^MT_JUMP_LOG2 raw words */
+void mt64_jump(MT64 *g)
+{
+	mt64_jump_init();
+	mt64_jump_poly(g, mtJumpPoly);
+}
+
+/* n non-overlapping streams, stream k starts k*2^MT_JUMP_LOG2 words after init(seed) */
+void mt64_streams(MT64 streams[], int n, unsigned long long seed)
+{
+	int k;
+
+	mt64_init(&streams[0], seed);
+	for(k=1; k<n; k++){
+		streams[k] = streams[k-1];
+		mt64_jump(&streams[k]);
+	}
+}
+
+#endif
@@ -0,0 +1,329 @@
+/*
+   Benchmarks of the simulation (-b), written as JSON so that the numbers
+   of different versions and engines can be compared.
+
+   Every benchmark runs its operation in batches that double until a batch
+   takes BENCH_SECONDS, and reports the last batch per operation:
+
+     urand             one draw of urand() on -r mt or philox, of the raw
+                       mt64_real3() and of urandBlock() per draw
+     infections_day    one day of infections_in_a_day() on the member,
+                       binomial, gillespie and tau engines, by prevalence (the
+                       fraction of the members in P1, P2, Is or Ia) and
+                       population size; the population is restored from a
+                       copy before every day, the copy is timed too
+     doTest, doAntigenTest, disclosurePCRresult
+                       one call on everybody at a prevalence of 0.1, by
+                       population size, restored the same way
+     replicate         one replicate of a scenario on one thread, by engine
+     scenarios         every scenario of the program with BENCH_REPS
+                       replicates each on all threads, by engine, per
+                       replicate; the MT streams are seeded and made
+                       before the timing
+
+   The draws come from fixed seeds: the MT streams of setRandomSeed() and
+   mt64_init(BENCH_SEED), the Philox keys of the replicates, so two runs
+   of the same version do the same work. BENCH_VERSION names the version
+   in the output, the Makefile passes it.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "variance.h"
+#include "sweep.h"
+
+#ifndef BENCH_SECONDS
+#define BENCH_SECONDS 0.2 // the least time of the batch that is reported
+#endif
+#ifndef BENCH_REPS
+#define BENCH_REPS 1000 // replicates per scenario of the scenarios benchmark
+#endif
+#ifndef BENCH_VERSION
+#define BENCH_VERSION "unknown"
+#endif
+#define BENCH_SEED 20240401ULL
+
+// one benchmark: runs the operation iterations times and returns a checksum, so that the work is not optimized away
+typedef double (*BENCHFUNC)(void *arg, long iterations);
+
+typedef struct benchOut {
+	FILE *fp;
+	int results; // results written so far
+	double checksum;
+} BENCHOUT;
+
+// what a benchmark works on
+typedef struct benchArg {
+	int engine;
+	int scenario;
+	int member;
+	double prevalence;
+	int stateNumber[STATES];
+	INDIV indiv; // the population the operation starts from every time
+	PARAMS par;
+	CHUNKFUNC runChunk;
+	MT64 stream;
+	MT64 *streams; // of the scenarios benchmark, seeded and made before it is timed
+} BENCHARG;
+
+static double benchNow(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+// time f until a batch takes BENCH_SECONDS and write the result, opsPerIteration operations per iteration
+static void benchRun(BENCHOUT *out, const char *name, const char *variant, BENCHFUNC f, BENCHARG *a, double opsPerIteration, const char *unit)
+{
+	long iterations;
+	double start, seconds, ops;
+
+	for(iterations=1; ; iterations*=2){
+		start = benchNow();
+		out->checksum += f(a, iterations);
+		seconds = benchNow() - start;
+		if(seconds >= BENCH_SECONDS || iterations >= (1L << 40)) break;
+	}
+	ops = opsPerIteration * iterations;
+	fprintf(out->fp, "%s    {\"name\": \"%s\", \"variant\": \"%s\", \"member\": %d, \"prevalence\": %g, \"unit\": \"%s\", \"operations\": %.0f, \"seconds\": %.6f, \"ns_per_op\": %.3f, \"ops_per_second\": %.6g}",
+		out->results ? ",\n" : "", name, variant, a->member, a->prevalence, unit, ops, seconds, 1e9 * seconds / ops, ops / seconds);
+	out->results++;
+}
+
+static double benchUrand(void *arg, long iterations)
+{
+	long i;
+	double sum = 0.0;
+
+	(void)arg; // the stream of the thread
+
+	for(i=0; i<iterations; i++) sum += urand();
+	return sum;
+}
+
+static double benchMtReal(void *arg, long iterations)
+{
+	BENCHARG *a = arg;
+	long i;
+	double sum = 0.0;
+
+	for(i=0; i<iterations; i++) sum += mt64_real3(&a->stream);
+	return sum;
+}
+
+static double benchUrandBlock(void *arg, long iterations)
+{
+	long i;
+	double sum = 0.0, block[MAX_MEMBER][2];
+
+	(void)arg; // the stream of the thread
+
+	for(i=0; i<iterations; i++){
+		urandBlock((int)(i & 0xFFFF), MAX_MEMBER, block);
+		sum += block[i % MAX_MEMBER][i & 1];
+	}
+	return sum;
+}
+
+static double benchDay(void *arg, long iterations)
+{
+	BENCHARG *a = arg;
+	long i;
+	int stateNumber[STATES];
+	INDIV indiv;
+
+	for(i=0; i<iterations; i++){
+		memcpy(stateNumber, a->stateNumber, sizeof(stateNumber));
+		indiv = a->indiv;
+		rngDay((int)(i & 0xFFFF));
+		rngAt(STEP_ENGINE, 0);
+		switch(a->engine){
+		  case ENGINE_MEMBER:
+			infections_in_a_day(stateNumber, &indiv, &a->par, 0);
+			break;
+		  case ENGINE_BINOMIAL:
+			infections_in_a_day_binomial(stateNumber, &indiv, &a->par, 0);
+			break;
+		  case ENGINE_GILLESPIE:
+			infections_in_a_day_gillespie(stateNumber, &indiv, &a->par);
+			break;
+		  case ENGINE_TAU:
+			infections_in_a_day_tau(stateNumber, &indiv, &a->par);
+			break;
+		}
+	}
+	return stateNumber[0];
+}
+
+// the test benchmarks, the engine field chooses the test
+#define BENCH_DOTEST 0
+#define BENCH_ANTIGEN 1
+#define BENCH_DISCLOSURE 2
+
+static double benchTest(void *arg, long iterations)
+{
+	BENCHARG *a = arg;
+	long i;
+	int stateNumber[STATES];
+	INDIV indiv;
+
+	for(i=0; i<iterations; i++){
+		memcpy(stateNumber, a->stateNumber, sizeof(stateNumber));
+		indiv = a->indiv;
+		rngDay((int)(i & 0xFFFF));
+		switch(a->engine){
+		  case BENCH_DOTEST:
+			doTest(a->member, &indiv, a->par.PCRSTV, 1 + a->par.readTime);
+			break;
+		  case BENCH_ANTIGEN:
+			doAntigenTest(a->member, stateNumber, &indiv, a->par.antigenSTV[0]);
+			break;
+		  case BENCH_DISCLOSURE:
+			disclosurePCRresult(a->member, stateNumber, &indiv, 1);
+			break;
+		}
+	}
+	return stateNumber[7];
+}
+
+static double benchReplicate(void *arg, long iterations)
+{
+	BENCHARG *a = arg;
+	RESULT total;
+
+	clearResult(&total);
+	a->runChunk(a->scenario, a->engine, 0, (int)iterations, &a->par, &total);
+	return total.numInfects;
+}
+
+static void benchNoReport(void *context, long point, const PARAMS *par, RESULT total[])
+{
+	(void)context;
+	(void)point;
+	(void)par;
+	(void)total;
+}
+
+static double benchScenarios(void *arg, long iterations)
+{
+	BENCHARG *a = arg;
+	long i;
+
+	for(i=0; i<iterations; i++) runPoints(&a->par, 1, a->engine, a->runChunk, a->streams, benchNoReport, NULL); // the chunks copy their streams
+	return 0.0;
+}
+
+// a population of member with round(prevalence member) members spread over P1, P2, Is and Ia,
+// half of them waiting for a PCR result read on day 1
+static void benchPopulation(BENCHARG *a, int member, double prevalence)
+{
+	int m, k = (int)(prevalence * member + 0.5), state;
+
+	a->member = a->par.member = member;
+	a->prevalence = prevalence;
+	initializePopulation(member, a->stateNumber, &a->indiv);
+	for(m=0; m<k; m++){
+		state = 2 + m % 4;
+		moveMember(&a->indiv, m, state);
+		a->stateNumber[0]--;
+		a->stateNumber[state]++;
+		if(m % 2 == 0){
+			setBit(a->indiv.testResult, m);
+			setBit(a->indiv.due[1], m);
+		}
+	}
+}
+
+// run every benchmark with the defaults of the program in base and write the JSON to fp
+void runBenchmarks(FILE *fp, const char *program, CHUNKFUNC runChunk, const PARAMS *base)
+{
+	static const char *engineName[] = {"member", "binomial", "gillespie", "wheel", "simd", "tau"};
+	static const char *testName[] = {"doTest", "doAntigenTest", "disclosurePCRresult"};
+	static const int members[] = {16, 50, 128, MAX_MEMBER};
+	static const double prevalences[] = {0.02, 0.1, 0.3};
+	const char *rngName = (rngMode == RNG_PHILOX) ? "philox" : "mt";
+	char variant[64];
+	int e, i, j, s, threads = 1;
+	BENCHOUT out;
+	BENCHARG *a = malloc(sizeof(BENCHARG));
+
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	out.fp = fp;
+	out.results = 0;
+	out.checksum = 0.0;
+	memset(a, 0, sizeof(BENCHARG));
+	a->par = *base;
+	a->runChunk = runChunk;
+	mt64_init(&a->stream, BENCH_SEED);
+	currentStream = &a->stream;
+	rngReplicate(0, 0);
+
+	fprintf(fp, "{\n  \"program\": \"%s\",\n  \"version\": \"%s\",\n  \"rng\": \"%s\",\n  \"threads\": %d,\n  \"bench_seconds\": %g,\n  \"results\": [\n",
+		program, BENCH_VERSION, rngName, threads, (double)BENCH_SECONDS);
+
+	// random numbers
+	benchRun(&out, "urand", rngName, benchUrand, a, 1.0, "draw");
+	benchRun(&out, "urand", "mt64_real3", benchMtReal, a, 1.0, "draw");
+	benchRun(&out, "urand", "philox_block", benchUrandBlock, a, 2.0 * MAX_MEMBER, "draw");
+
+	// one day of the infection process
+	for(e=ENGINE_MEMBER; e<=ENGINE_TAU; e++){
+		if(e == ENGINE_WHEEL || e == ENGINE_SIMD) continue; // their state is not the population alone
+		for(i=0; i<(int)(sizeof(members)/sizeof(members[0])); i++){
+			for(j=0; j<(int)(sizeof(prevalences)/sizeof(prevalences[0])); j++){
+				a->engine = e;
+				benchPopulation(a, members[i], prevalences[j]);
+				deriveParams(&a->par);
+				benchRun(&out, "infections_day", engineName[e], benchDay, a, 1.0, "day");
+			}
+		}
+	}
+
+	// the tests
+	for(e=BENCH_DOTEST; e<=BENCH_DISCLOSURE; e++){
+		for(i=0; i<(int)(sizeof(members)/sizeof(members[0])); i++){
+			a->engine = e;
+			benchPopulation(a, members[i], 0.1);
+			deriveParams(&a->par);
+			benchRun(&out, testName[e], rngName, benchTest, a, 1.0, "call");
+		}
+	}
+
+	// whole replicates and whole runs with the defaults
+	a->par = *base;
+	a->member = base->member;
+	a->prevalence = 0.0;
+	a->par.reps = BENCH_REPS;
+	a->par.precision = 0.0;
+	a->streams = malloc(streamsFor(&a->par, 1) * sizeof(MT64));
+	if(rngMode == RNG_MT){ // all the streams, their jumps are not the simulation
+		setRandomSeed(a->streams);
+		randomStream(a->streams, streamsFor(&a->par, 1) - 1);
+	}
+	for(e=ENGINE_MEMBER; e<=ENGINE_TAU; e++){
+		a->engine = e;
+		for(s=0; s<nScenarios; s++){
+			a->scenario = s;
+			snprintf(variant, sizeof(variant), "%s/scenario%d", engineName[e], s);
+			mt64_init(&a->stream, BENCH_SEED);
+			currentStream = &a->stream; // runPoints() leaves it on a stream of its own
+			benchRun(&out, "replicate", variant, benchReplicate, a, 1.0, "replicate");
+		}
+		benchRun(&out, "scenarios", engineName[e], benchScenarios, a, (double)BENCH_REPS * nScenarios, "replicate");
+	}
+
+	fprintf(fp, "\n  ],\n  \"checksum\": %.17g\n}\n", out.checksum);
+	free(a->streams);
+	free(a);
+}
+
+#endif
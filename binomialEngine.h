@@ -0,0 +1,137 @@
+/*
+   Count-based engine for the infection process within a day (-e binomial).
+
+   Members in the same state are exchangeable, so instead of one urand()
+   per member per ONE_T step, the number of members leaving each state in
+   a step is drawn as a binomial variate. Members are tracked as cohorts,
+   flow[q][a][s] = members with quarantine q who were in state a at the
+   start of the day and are in state s now. Which members of a cohort moved
+   is decided only once, at the end of the day, because the daily symptom
+   check and the tests need the state of every member.
+*/
+
+#ifndef BINOMIALENGINE_H
+#define BINOMIALENGINE_H
+
+#include "model.h"
+
+// number of successes in n Bernoulli trials with probability p
+int binomial(int n, double p)
+{
+	int k, half;
+	double u, f, r;
+
+	if(n <= 0 || p <= 0.0) return 0;
+	if(p >= 1.0) return n;
+	if(p > 0.5) return n - binomial(n, 1.0 - p);
+	if((double)n * p > 30.0){ // keep (1-p)^n away from underflow
+		half = n/2;
+		return binomial(half, p) + binomial(n - half, p);
+	}
+
+	// inversion, walk up the cumulative distribution from k = 0
+	r = p / (1.0 - p);
+	f = exp((double)n * log1p(-p));
+	u = urand();
+	for(k=0; u > f && k < n; k++){
+		u -= f;
+		f *= r * (double)(n - k) / (double)(k + 1);
+	}
+	return k;
+}
+
+typedef struct cohorts {
+	int flow[2][STATES][STATES]; // [quarantine][state at the start of the day][state now]
+	int member[2][STATES][MAX_MEMBER]; // members of each cohort
+	int size[2][STATES]; // cohort sizes
+} COHORTS;
+
+// one cohort per (quarantine, state) at the start of the day
+void beginCohorts(COHORTS *c, INDIV *indiv, int n)
+{
+	int member, q, a;
+
+	memset(c->flow, 0, sizeof(c->flow));
+	memset(c->size, 0, sizeof(c->size));
+	for(member=0; member<n; member++){
+		q = testBit(indiv->quarantine, member);
+		a = indiv->state[member];
+		c->member[q][a][c->size[q][a]++] = member;
+		c->flow[q][a][a]++;
+	}
+}
+
+// decide who moved: draw flow[q][a][s] members of each cohort for every s != a
+void assignCohorts(COHORTS *c, INDIV *indiv)
+{
+	int q, a, s, k, n, pos, j, member;
+
+	for(q=0; q<2; q++){
+		for(a=0; a<6; a++){
+			n = c->size[q][a];
+			if(c->flow[q][a][a] == n) continue; // nobody left this cohort
+			pos = 0;
+			for(s=a+1; s<=6; s++){
+				for(j=0; j<c->flow[q][a][s]; j++){ // partial Fisher-Yates shuffle
+					k = pos + (int)((double)(n - pos) * urand());
+					member = c->member[q][a][k];
+					c->member[q][a][k] = c->member[q][a][pos];
+					c->member[q][a][pos++] = member;
+					moveMember(indiv, member, s);
+				}
+			}
+		}
+	}
+}
+
+void infections_in_a_day_binomial(int stateNumber[], INDIV *indiv, const PARAMS *par, int firstStep)
+{
+	int t, q, a, s, k, k4, next;
+	double p[STATES];
+	COHORTS c;
+
+	beginCohorts(&c, indiv, par->member);
+
+	p[1] = par->sigma; // E -> P1
+	p[2] = par->rho; // P1 -> P2
+	p[3] = par->rho; // P2 -> Is or Ia
+	p[4] = par->gamma; // Is -> R
+	p[5] = par->gamma; // Ia -> R
+
+	for(t=firstStep; t<par->oneT; t++){
+		p[0] = par->beta*(double)(stateNumber[2] + stateNumber[3] + stateNumber[4] + stateNumber[5]);
+		for(q=0; q<2; q++){
+			for(a=0; a<6; a++){
+				if(c.size[q][a] == 0) continue;
+				// from the later states down, so that a member moves at most once in a step
+				for(s=5; s>=a; s--){
+					k = binomial(c.flow[q][a][s], p[s]);
+					if(k == 0) continue;
+					c.flow[q][a][s] -= k;
+					if(s == 3){ // P2 individuals will be either Is or Ia
+						k4 = binomial(k, par->eta);
+						c.flow[q][a][4] += k4;
+						c.flow[q][a][5] += k - k4;
+						// change the stateNumber only when these individuals are not quarantined
+						if(q == 0){
+							stateNumber[3] -= k;
+							stateNumber[4] += k4;
+							stateNumber[5] += k - k4;
+						}
+					} else {
+						next = (s < 4) ? s + 1 : 6;
+						c.flow[q][a][next] += k;
+						if(q == 0){
+							stateNumber[s] -= k;
+							stateNumber[next] += k;
+						}
+					}
+				}
+			}
+		}
+	} // one_t
+
+	assignCohorts(&c, indiv);
+}
+
+#endif
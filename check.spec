@@ -0,0 +1,6 @@
+# the regression checks (make check), a few hundred replicates at two team
+# sizes and two R_0 so that both outbreak regimes and the cease of a team
+# within and at the end of a week are compared
+MEMBER = 16, 50
+R_0 = 2.5, 5
+reps = 400
@@ -0,0 +1,230 @@
+/*
+   Checkpoints of a run (-c file), so that a run that is killed resumes
+   where it stopped instead of from the start.
+
+   A chunk of replicates depends on its (point, scenario, chunk) alone:
+   its MT stream is a jump ahead from the seed and its Philox keys are its
+   replicates. The state of a run is therefore the set of chunks done and
+   their results, the accumulators, and no generator state needs to be
+   saved. At most every CHECKPOINT_SECONDS, after a chunk, they are written
+   to file atomically: to file.tmp, synced, then renamed over file.
+
+   Run again with the same command line and file, runPoints() reads them
+   back, runs only the chunks that are missing and merges every chunk in
+   the same order and the same rounds as before, so the output is
+   bit-identical to that of a run that was never stopped. The points are
+   reported again from the start. The file carries a fingerprint of the
+   run (the parameters of every point, the engine, the generator and the
+   modes), a file of another run is refused. It is removed when the run
+   is over.
+
+   SIGTERM or SIGINT, as a batch system sends before it pre-empts a job,
+   makes the next chunk that ends write a checkpoint at once and stop the
+   run.
+
+   The same files split a run over processes or machines. Shard i of N
+   (-S i/N -c file) runs the chunks c with c % N == i, on the streams of
+   those chunks as in a single process, reports nothing and keeps its
+   file, a checkpoint of its chunks. The merge (-m file -m file ...) reads
+   the files of all shards, and with every chunk present merges and
+   reports them as a single process would, bit for bit. The shards and
+   the merge have the same command line otherwise, and the rounds of a
+   precision (-p) need the merged results, so shards run without one.
+*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include "model.h"
+
+#ifndef CHECKPOINT_SECONDS
+#define CHECKPOINT_SECONDS 60 // the least time between two checkpoints
+#endif
+#define CHECKPOINT_MAGIC 0x314b504354534554ULL // "TESTCPK1"
+
+static const char *checkpointName = NULL; // -c file, NULL: no checkpoints
+static unsigned long long checkpointSalt = 0; // what else identifies the run, the policies of -t
+static double lastCheckpoint;
+static volatile sig_atomic_t checkpointStop = 0; // 1: a signal asked the run to stop
+static int shardIndex = 0, shardCount = 1; // -S shardIndex/shardCount, runs the chunks c % shardCount == shardIndex
+static const char **mergeNames = NULL; // -m, the files of the shards to merge
+static int nMerge = 0;
+
+typedef struct checkpointHeader {
+	unsigned long long magic;
+	unsigned long long fingerprint;
+	long nTasks; // chunks of the run
+	long nDone;
+	int resultSize; // sizeof(RESULT) of the build
+} CHECKPOINTHEADER;
+
+// FNV-1a of n bytes, continued from h
+unsigned long long hashBytes(const void *data, size_t n, unsigned long long h)
+{
+	const unsigned char *p = data;
+	size_t i;
+
+	if(h == 0) h = 0xcbf29ce484222325ULL;
+	for(i=0; i<n; i++){
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+// what the results of the chunks depend on besides their coordinates
+unsigned long long runFingerprint(const PARAMS par[], long nPoints, int engine)
+{
+	int config[9] = {engine, rngMode, fastForward, varianceMode, commonNumbers, nScenarios, lockstep, REPS_PER_CHUNK, (int)sizeof(PARAMS)};
+	unsigned long long h;
+
+	h = hashBytes(config, sizeof(config), 0);
+	h = hashBytes(&checkpointSalt, sizeof(checkpointSalt), h);
+	return hashBytes(par, nPoints * sizeof(PARAMS), h);
+}
+
+static void stopAtCheckpoint(int signal)
+{
+	(void)signal; // SIGINT or SIGTERM alike
+	checkpointStop = 1;
+}
+
+// checkpoints of the run to fileName
+void startCheckpoints(const char *fileName)
+{
+	checkpointName = fileName;
+	signal(SIGTERM, stopAtCheckpoint);
+	signal(SIGINT, stopAtCheckpoint);
+}
+
+static double checkpointClock(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+// add the chunks done in a file of the run to done[] and chunkTotal[], returns the number of chunks read,
+// 0 without the file unless required, -1 and prints the reason if the file is of another run or broken
+long loadCheckpoint(const char *fileName, int required, unsigned long long fingerprint, long nTasks, unsigned char done[], RESULT chunkTotal[])
+{
+	FILE *fp;
+	CHECKPOINTHEADER h;
+	unsigned char *inFile = NULL;
+	long i, n = 0;
+
+	lastCheckpoint = checkpointClock();
+	fp = fopen(fileName, "rb");
+	if(fp == NULL){
+		if(!required) return 0; // a new run
+		fprintf(stderr, "%s: cannot open\n", fileName);
+		return -1;
+	}
+	if(fread(&h, sizeof(h), 1, fp) != 1 || h.magic != CHECKPOINT_MAGIC || h.resultSize != (int)sizeof(RESULT)) goto bad;
+	if(h.fingerprint != fingerprint || h.nTasks != nTasks){
+		fprintf(stderr, "%s: a checkpoint of another run, remove it to start again\n", fileName);
+		fclose(fp);
+		return -1;
+	}
+	inFile = malloc(nTasks);
+	if(fread(inFile, 1, nTasks, fp) != (size_t)nTasks) goto bad;
+	for(i=0; i<nTasks; i++){
+		if(!inFile[i]) continue;
+		if(fread(&chunkTotal[i], sizeof(RESULT), 1, fp) != 1) goto bad;
+		done[i] = 1;
+		n++;
+	}
+	fclose(fp);
+	free(inFile);
+	if(n != h.nDone) goto bad2;
+	return n;
+
+  bad:
+	fclose(fp);
+	free(inFile);
+  bad2:
+	fprintf(stderr, "%s: broken checkpoint\n", fileName);
+	return -1;
+}
+
+// read the files of the shards, -1 and prints the reason unless every chunk of the run is in them
+int mergeShards(unsigned long long fingerprint, long nTasks, unsigned char done[], RESULT chunkTotal[])
+{
+	int f;
+	long i, missing = 0;
+
+	for(f=0; f<nMerge; f++)
+		if(loadCheckpoint(mergeNames[f], 1, fingerprint, nTasks, done, chunkTotal) < 0) return -1;
+	for(i=0; i<nTasks; i++) missing += !done[i];
+	if(missing > 0){
+		fprintf(stderr, "%ld of %ld chunks are in none of the shards\n", missing, nTasks);
+		return -1;
+	}
+	return 0;
+}
+
+// write the chunks done so far if the last checkpoint is CHECKPOINT_SECONDS old or if force, and
+// stop the run after it if a signal asked to; done[i] is set with an atomic write after chunkTotal[i]
+// is complete and flushed
+void saveCheckpoint(unsigned long long fingerprint, long nTasks, const unsigned char done[], const RESULT chunkTotal[], int force)
+{
+	char tmpName[4096];
+	unsigned char *snapshot;
+	CHECKPOINTHEADER h;
+	FILE *fp;
+	long i;
+	int ok;
+
+	if(checkpointName == NULL) return;
+#ifdef _OPENMP
+	#pragma omp critical(checkpoint)
+#endif
+	if(force || checkpointStop || checkpointClock() - lastCheckpoint >= CHECKPOINT_SECONDS){
+		snapshot = malloc(nTasks);
+		h.magic = CHECKPOINT_MAGIC;
+		h.fingerprint = fingerprint;
+		h.nTasks = nTasks;
+		h.nDone = 0;
+		h.resultSize = (int)sizeof(RESULT);
+		for(i=0; i<nTasks; i++){
+#ifdef _OPENMP
+			#pragma omp atomic read
+#endif
+			snapshot[i] = done[i];
+			h.nDone += snapshot[i];
+		}
+#ifdef _OPENMP
+		#pragma omp flush
+#endif
+		snprintf(tmpName, sizeof(tmpName), "%s.tmp", checkpointName);
+		fp = fopen(tmpName, "wb");
+		ok = (fp != NULL);
+		if(ok){
+			ok = fwrite(&h, sizeof(h), 1, fp) == 1 && fwrite(snapshot, 1, nTasks, fp) == (size_t)nTasks;
+			for(i=0; ok && i<nTasks; i++) if(snapshot[i]) ok = fwrite(&chunkTotal[i], sizeof(RESULT), 1, fp) == 1;
+			ok = (fflush(fp) == 0) && ok && fsync(fileno(fp)) == 0;
+			ok = (fclose(fp) == 0) && ok && rename(tmpName, checkpointName) == 0;
+		}
+		if(!ok) fprintf(stderr, "%s: cannot write the checkpoint\n", checkpointName);
+		free(snapshot);
+		lastCheckpoint = checkpointClock();
+		if(checkpointStop){
+			fprintf(stderr, "%s: stopped after %ld of %ld chunks, run again to resume\n", checkpointName, h.nDone, nTasks);
+			exit(1);
+		}
+	}
+}
+
+// the run is over, the file of a shard is kept for the merge
+void endCheckpoints(unsigned long long fingerprint, long nTasks, const unsigned char done[], const RESULT chunkTotal[])
+{
+	if(checkpointName == NULL) return;
+	if(shardCount > 1) saveCheckpoint(fingerprint, nTasks, done, chunkTotal, 1);
+	else remove(checkpointName);
+}
+
+#endif
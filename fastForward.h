@@ -0,0 +1,108 @@
+/*
+   Fast-forward through quiescent periods of a replicate (-f), for the
+   engines that run every ONE_T step (member and binomial).
+
+   When nobody in the population is infectious the force of infection is
+   0, and the only changes to the population are E members moving to P1,
+   each with probability sigma per step. The step of the first such move
+   is geometric, so it is drawn at once, and the engine is skipped until
+   the day it falls in while the daily routine (tests, game days, weekly
+   checks) runs as usual. That routine cannot end the quiescence, since it
+   only isolates members. On that day the quarantined members catch up
+   with the skipped steps through their geometric sojourn times, the E
+   members that move in the step are drawn, and the engine continues from
+   the next step.
+
+   The replicates have the same distribution as without -f but use other
+   random numbers, so the output is not bit-identical.
+*/
+
+#ifndef FASTFORWARD_H
+#define FASTFORWARD_H
+
+#include "model.h"
+
+typedef struct quiet {
+	long long since; // step at which the quiescent period began
+	long long until; // step of the first E -> P1 in the population, -1: not quiescent
+} QUIET;
+
+// probability per step to leave each of the states E, P1, P2, Is and Ia
+static inline double leaveProbability(const PARAMS *par, int state)
+{
+	return (state == 1) ? par->sigma : (state <= 3) ? par->rho : par->gamma;
+}
+
+// advance the quarantined members by the given number of steps, their sojourns are geometric and memoryless
+void advanceQuarantined(INDIV *indiv, const PARAMS *par, long long steps)
+{
+	int w, member, state;
+	long long left, stay;
+	unsigned long long bits;
+
+	for(w=0; 64*w<par->member; w++){
+		for(bits = indiv->quarantine[w] & indiv->infected[w]; bits; bits &= bits-1){
+			member = 64*w + LOWEST(bits);
+			state = indiv->state[member];
+			for(left = steps; state >= 1 && state <= 5; left -= stay){
+				stay = 1 + (long long)(log(urand()) / log1p(-leaveProbability(par, state)));
+				if(stay > left) break;
+				if(state == 3) state = (urand() < par->eta) ? 4 : 5; // P2 individuals will be either Is or Ia
+				else state = (state < 4) ? state + 1 : 6;
+				moveMember(indiv, member, state);
+			}
+		}
+	}
+}
+
+// the E members of the population that move to P1 in a step with at least one move
+void moveExposed(int stateNumber[], INDIV *indiv, const PARAMS *par)
+{
+	int w, member, k, first, i;
+	double stay = 1.0 - par->sigma, none;
+	unsigned long long bits;
+
+	// the first of the k members to move is a geometric number truncated at k
+	k = stateNumber[1];
+	none = pow(stay, (double)k);
+	first = (int)(log(1.0 - urand() * (1.0 - none)) / log(stay));
+	if(first > k - 1) first = k - 1;
+
+	i = 0;
+	for(w=0; 64*w<par->member; w++){
+		for(bits = memberWord(par->member, w) & ~indiv->quarantine[w]; bits; bits &= bits-1){
+			member = 64*w + LOWEST(bits);
+			if(indiv->state[member] != 1) continue;
+			if(i == first || (i > first && urand() < par->sigma)){
+				moveMember(indiv, member, 2);
+				stateNumber[1]--;
+				stateNumber[2]++;
+			}
+			i++;
+		}
+	}
+}
+
+// the first step of day d for the engine, par->oneT when the whole day is quiescent
+int skipQuiescent(QUIET *q, int d, int stateNumber[], INDIV *indiv, const PARAMS *par)
+{
+	long long dayStart = (long long)d * par->oneT, step;
+
+	if(q->until < 0){
+		if(stateNumber[2] + stateNumber[3] + stateNumber[4] + stateNumber[5] > 0 || stateNumber[1] == 0) return 0;
+		rngAt(STEP_FAST, 0);
+		q->since = dayStart;
+		q->until = dayStart + (long long)(log(urand()) / (stateNumber[1] * log1p(-par->sigma)));
+	}
+	if(q->until >= dayStart + par->oneT) return par->oneT;
+
+	// the quiescent period ends in this day
+	rngAt(STEP_FAST, 1);
+	advanceQuarantined(indiv, par, q->until - q->since + 1);
+	moveExposed(stateNumber, indiv, par);
+	step = q->until - dayStart;
+	q->until = -1;
+	return (int)step + 1;
+}
+
+#endif
@@ -0,0 +1,542 @@
+/*
+   The measure items without sampling error (-F tolerance): the
+   probability distribution of a replicate over the counts of its states,
+   propagated day by day by the finite state projection of the master
+   equation (Munsky and Khammash 2006), in place of the replicates.
+
+   A state of the distribution is the members in S, E, P1, P2, Is and Ia
+   who are not isolated, the isolations of the week (0,..., 4, 5: more
+   than 4, 6: the mass infection is counted), the mode of the escalated
+   tests and the day of week and PCR parity the replicate drew. R and the
+   isolated members are the rest of the population: the isolated keep
+   progressing but nothing the replicate measures sees them again. The
+   states are packed into 64 bits and kept in a hash table (FSPSTATES)
+   that holds only the states reached.
+
+   A day maps the distribution as the daily routine does a replicate. In
+   the morning a test isolates every member in P1, P2 or Ia binomially
+   with its sensitivity and the game of Saturday adds to the games and the
+   infectious players. The infection process of the day is the
+   continuous-time model of the gillespie engine, solved by
+   uniformization: p(1) = sum_k Poisson(k; L) (I + A/L)^k p(0), A the
+   sparse generator and L at least the rate out of every state reached.
+   Each (I + A/L) is a matrix-vector product over the states in parallel,
+   every state pulling from its predecessors, which are linked once per
+   day when a state first carries FSP_CUT times the tolerance in a term.
+   The evening does the checks of the end of the day and the symptom
+   check of the next morning, which isolates Is, so that a day starts with
+   no member in Is and the states stay few. The member and binomial
+   engines are the same model in ONE_T steps, their results differ from
+   these by the steps.
+
+   States below the tolerance are dropped every morning, with the tail of
+   the Poisson sums and what leaves the states that are not linked, and
+   the probability lost is written after the items of every scenario: the
+   items are the means over the rest, a probability is right within the
+   loss. The tests must isolate at once (none, antigen, or pcr and
+   antigen+pcr read at once) so that the counts are a Markov chain; the
+   scenarios come from a policy file (-t) and the points from -s.
+
+   The states above the tolerance grow with the product of the spreads of
+   the counts, and the loss biases the items toward the small outbreaks,
+   so the tolerance must keep it small. A scenario of a team of 6 takes
+   about a second at 1e-9, with a loss near 1e-5; one of a team of 16
+   takes minutes at 1e-10, with a loss near 1e-4, and loses a tenth or
+   more of its probability at 1e-6. A team of 50 spreads over some 1e7
+   states at the peak of an outbreak, more than the memory of a
+   workstation at a tolerance that keeps the loss small.
+*/
+
+#ifndef FSP_H
+#define FSP_H
+
+#include "schedule.h"
+#include "sweep.h"
+
+#define FSP_MAX_MEMBER 255 // the counts are 8 bits
+#define FSP_PENDING 31 // the mode of a replicate whose tests escalate after the next tests
+#define FSP_MAX_EVERY 30 // days between escalated tests, the modes 1,..., every
+#define FSP_WEEK 48 // bit of the isolations of the week, 3 bits
+#define FSP_MODE 51 // 0: regular tests, 1 + addTestDays % every: escalated, or FSP_PENDING; 5 bits
+#define FSP_DAY 56 // the day of week of day 0 (dayBegin), 3 bits
+#define FSP_PARITY 59 // the PCR parity (lastPCR), 1 bit
+#define FSP_REACTIONS 7
+#define FSP_MAX_LEAP 400.0 // largest L of a uniformization, exp(-L) stays a normal double
+#define FSP_TAIL 1e-3 // Poisson tail left out of a day relative to the tolerance
+#define FSP_CUT 1e-2 // probability in a term of the sum that links a state to its successors, relative to the tolerance
+
+// a field of a state
+static inline int fspField(unsigned long long key, int bit, int bits)
+{
+	return (int)(key >> bit & ((1ULL << bits) - 1));
+}
+
+static inline unsigned long long fspSetField(unsigned long long key, int bit, int bits, int value)
+{
+	return (key & ~(((1ULL << bits) - 1) << bit)) | (unsigned long long)value << bit;
+}
+
+// the states of a distribution, with the vectors and predecessors of the uniformization
+typedef struct fspStates {
+	long n, size; // states, room for them
+	long mask; // slots of the hash table - 1, twice the room
+	int *slot; // index + 1 of the state in a slot, 0: empty
+	unsigned long long *key;
+	double *p; // probability
+	double *start, *v, *next; // p at the start of a leap, the k-th and (k+1)-th vectors of the sum
+	int *pred; // pred[FSP_REACTIONS*i + r]: the state that reaction r brings to state i, -1: none linked
+	unsigned char *expanded; // 1: the state is linked to its successors
+} FSPSTATES;
+
+// the sums of a scenario over the replicates that end, weighted by their probability
+typedef struct fspTotal {
+	double mass, finalSize, ceaseDay, massInfection, games, infectedInGame, lost;
+} FSPTOTAL;
+
+// the reactions of the infection process, members move from compartment fspFrom[r] to fspTo[r], -1: R
+static const int fspFrom[FSP_REACTIONS] = {0, 1, 2, 3, 3, 4, 5};
+static const int fspTo[FSP_REACTIONS] = {1, 2, 3, 4, 5, -1, -1};
+
+static inline long fspHash(const FSPSTATES *st, unsigned long long key)
+{
+	return (long)((key * 0x9E3779B97F4A7C15ULL) >> 20) & st->mask;
+}
+
+static void fspResize(FSPSTATES *st, long size)
+{
+	long i, h;
+
+	st->size = size;
+	st->key = realloc(st->key, size * sizeof(unsigned long long));
+	st->p = realloc(st->p, size * sizeof(double));
+	st->start = realloc(st->start, size * sizeof(double));
+	st->v = realloc(st->v, size * sizeof(double));
+	st->next = realloc(st->next, size * sizeof(double));
+	st->pred = realloc(st->pred, FSP_REACTIONS * size * sizeof(int));
+	st->expanded = realloc(st->expanded, size);
+	st->mask = 2 * size - 1;
+	free(st->slot);
+	st->slot = calloc(2 * size, sizeof(int));
+	for(i=0; i<st->n; i++){
+		for(h = fspHash(st, st->key[i]); st->slot[h]; h = (h + 1) & st->mask);
+		st->slot[h] = (int)i + 1;
+	}
+}
+
+FSPSTATES *newStates(long size)
+{
+	FSPSTATES *st = calloc(1, sizeof(FSPSTATES));
+
+	fspResize(st, size);
+	return st;
+}
+
+void freeStates(FSPSTATES *st)
+{
+	free(st->slot);
+	free(st->key);
+	free(st->p);
+	free(st->start);
+	free(st->v);
+	free(st->next);
+	free(st->pred);
+	free(st->expanded);
+	free(st);
+}
+
+static void fspClear(FSPSTATES *st)
+{
+	st->n = 0;
+	memset(st->slot, 0, (st->mask + 1) * sizeof(int));
+}
+
+// the index of a state, added with probability 0 if it is not in the table; *added tells which
+long fspState(FSPSTATES *st, unsigned long long key, int *added)
+{
+	long h, i;
+	int r;
+
+	for(h = fspHash(st, key); st->slot[h]; h = (h + 1) & st->mask)
+		if(st->key[st->slot[h] - 1] == key){
+			*added = 0;
+			return st->slot[h] - 1;
+		}
+	if(st->n == st->size){
+		fspResize(st, 2 * st->size);
+		for(h = fspHash(st, key); st->slot[h]; h = (h + 1) & st->mask);
+	}
+	i = st->n++;
+	st->slot[h] = (int)i + 1;
+	st->key[i] = key;
+	st->p[i] = st->start[i] = st->v[i] = st->next[i] = 0.0;
+	for(r=0; r<FSP_REACTIONS; r++) st->pred[FSP_REACTIONS*i + r] = -1;
+	st->expanded[i] = 0;
+	*added = 1;
+	return i;
+}
+
+static inline void fspAdd(FSPSTATES *st, unsigned long long key, double p)
+{
+	int added;
+	long i = fspState(st, key, &added); // before st->p, which it can move
+
+	st->p[i] += p;
+}
+
+// the rate of reaction r out of a state
+static inline double fspRate(unsigned long long key, int r, const double rate[], double eta)
+{
+	int from = fspField(key, 8*fspFrom[r], 8);
+
+	switch(r){
+	  case 0: // infection by P1, P2, Is and Ia
+		return rate[0] * from * (fspField(key, 8*2, 8) + fspField(key, 8*3, 8) + fspField(key, 8*4, 8) + fspField(key, 8*5, 8));
+	  case 3: // P2 -> Is
+		return rate[3] * eta * from;
+	  case 4: // P2 -> Ia
+		return rate[3] * (1.0 - eta) * from;
+	  default:
+		return rate[fspFrom[r]] * from;
+	}
+}
+
+// the rate out of a state
+static inline double fspOut(unsigned long long key, const double rate[], double eta)
+{
+	int r;
+	double out = 0.0;
+
+	for(r=0; r<FSP_REACTIONS; r++) out += fspRate(key, r, rate, eta);
+	return out;
+}
+
+// the state after reaction r
+static inline unsigned long long fspReaction(unsigned long long key, int r)
+{
+	key -= 1ULL << 8*fspFrom[r];
+	if(fspTo[r] >= 0) key += 1ULL << 8*fspTo[r];
+	return key;
+}
+
+// v <- (I + A/lambda) v over all states, every state pulls from its predecessors
+static void fspProduct(FSPSTATES *st, const double rate[], double eta, double lambda)
+{
+	long i;
+	int r, j;
+	double x, *swap;
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) private(r, j, x)
+#endif
+	for(i=0; i<st->n; i++){
+		x = st->v[i] * (1.0 - fspOut(st->key[i], rate, eta) / lambda);
+		for(r=0; r<FSP_REACTIONS; r++)
+			if((j = st->pred[FSP_REACTIONS*i + r]) >= 0 && st->v[j] != 0.0) x += fspRate(st->key[j], r, rate, eta) * st->v[j] / lambda;
+		st->next[i] = x;
+	}
+	swap = st->v;
+	st->v = st->next;
+	st->next = swap;
+}
+
+// the infection process over a time h by uniformization, leaving out a Poisson tail of probability tail;
+// the states that never carry cut in a term of the sum are not linked, what leaves them is lost
+static void fspLeap(FSPSTATES *st, const double rate[], double eta, double h, double tail, double cut)
+{
+	long i, j, n;
+	int r, k, added, restart;
+	double lambda = 0.0, weight, sum, out;
+
+	for(i=0; i<st->n; i++){
+		st->start[i] = st->p[i];
+		if((out = fspOut(st->key[i], rate, eta)) > lambda) lambda = out;
+	}
+	do {
+		lambda = 1.25 * lambda + 1e-9; // room for the states reached in the leap
+		if(lambda * h > FSP_MAX_LEAP){ // in two halves
+			for(i=0; i<st->n; i++) st->p[i] = st->start[i];
+			fspLeap(st, rate, eta, h / 2.0, tail / 2.0, cut);
+			fspLeap(st, rate, eta, h / 2.0, tail / 2.0, cut);
+			return;
+		}
+		restart = 0;
+		weight = exp(-lambda * h);
+		for(i=0; i<st->n; i++){
+			st->v[i] = st->start[i];
+			st->p[i] = weight * st->v[i];
+		}
+		sum = weight;
+		for(k=1; 1.0 - sum > tail; k++){
+			// link the states that carry cut for the first time to their successors
+			n = st->n;
+			for(i=0; i<n; i++){
+				if(st->expanded[i] || st->v[i] < cut) continue;
+				st->expanded[i] = 1;
+				for(r=0; r<FSP_REACTIONS; r++){
+					if(fspRate(st->key[i], r, rate, eta) <= 0.0) continue;
+					j = fspState(st, fspReaction(st->key[i], r), &added);
+					st->pred[FSP_REACTIONS*j + r] = (int)i;
+					if(added && (out = fspOut(st->key[j], rate, eta)) > lambda){
+						lambda = out; // too small for the new state, again with more room
+						restart = 1;
+					}
+				}
+			}
+			if(restart) break;
+			fspProduct(st, rate, eta, lambda);
+			weight *= lambda * h / k;
+			sum += weight;
+			for(i=0; i<st->n; i++) st->p[i] += weight * st->v[i];
+		}
+	} while(restart);
+}
+
+// the probabilities of 0,..., n positives among n members tested with sensitivity q
+static void fspBinomial(int n, double q, double pmf[])
+{
+	int k, j;
+
+	pmf[0] = 1.0;
+	for(k=0; k<n; k++){ // one member more at a time
+		pmf[k+1] = pmf[k] * q;
+		for(j=k; j>0; j--) pmf[j] = pmf[j] * (1.0 - q) + pmf[j-1] * q;
+		pmf[0] *= 1.0 - q;
+	}
+}
+
+// the isolation probability of each state in a test, NULL: no test
+static const double *fspTest(int scenario, int test, const PARAMS *par, double q[STATES])
+{
+	int s;
+
+	for(s=0; s<STATES; s++){
+		switch(test){
+		  case TEST_ANTIGEN:
+			q[s] = par->antigenSTV[scenario][s];
+			break;
+		  case TEST_PCR:
+			q[s] = par->PCRSTV[s];
+			break;
+		  case TEST_ANTIGEN_PCR:
+			q[s] = par->antigenSTV[scenario][s] * par->PCRSTV[s];
+			break;
+		  default:
+			return NULL;
+		}
+	}
+	return q;
+}
+
+// the isolations of the week after k more
+static inline unsigned long long fspIsolate(unsigned long long key, int k)
+{
+	int week = fspField(key, FSP_WEEK, 3);
+
+	if(week < 6) week = (week + k > 5) ? 5 : week + k;
+	return fspSetField(key, FSP_WEEK, 3, week);
+}
+
+// the routine of day d before the infection process, from the states of from into to: the tests of the
+// scenario and the game; drops the states below the tolerance into the loss
+static void fspMorning(FSPSTATES *from, FSPSTATES *to, int scenario, int d, int calendar, const PARAMS *par, double tolerance, FSPTOTAL *t)
+{
+	const SCHEDULE *sc = &schedules[scenario];
+	long i;
+	int whatDay, mode, test, isolated, c[6], k[6], s;
+	unsigned long long key, moved;
+	double p, pk, g, q[STATES], pmf[6][FSP_MAX_MEMBER + 1];
+	const double *sensitivity;
+
+	fspClear(to);
+	for(i=0; i<from->n; i++){
+		if((p = from->p[i]) < tolerance){
+			t->lost += p;
+			continue;
+		}
+		key = from->key[i];
+		whatDay = (fspField(key, FSP_DAY, 3) + d) % 7;
+
+		// the test of the day, the regular one until the tests escalate
+		mode = fspField(key, FSP_MODE, 5);
+		if(mode == 0 || mode == FSP_PENDING)
+			test = sc->test[(sc->phase < 0) ? (d/7 + 2 - fspField(key, FSP_PARITY, 1)) % 2 : (d/7) % sc->period][whatDay];
+		else {
+			test = (mode == 1) ? sc->escalation : TEST_NONE;
+			key = fspSetField(key, FSP_MODE, 5, mode % sc->every + 1);
+		}
+		if(mode == FSP_PENDING) key = fspSetField(key, FSP_MODE, 5, 1);
+		sensitivity = fspTest(scenario, test, par, q);
+		for(s=2; s<6; s++){
+			c[s] = (sensitivity != NULL && sensitivity[s] > 0.0) ? fspField(key, 8*s, 8) : 0; // the members a test can find
+			k[s] = 0;
+			fspBinomial(c[s], (sensitivity != NULL) ? sensitivity[s] : 0.0, pmf[s]);
+		}
+		g = calendar ? (whatDay == 0) : 1.0 / 7.0; // the weight of the Saturday game, every day of week alike without a calendar
+
+		// every number of positives in P1, P2 and Ia
+		for(;;){
+			pk = p;
+			moved = key;
+			for(s=2; s<6; s++){
+				pk *= pmf[s][k[s]];
+				moved -= (unsigned long long)k[s] << 8*s;
+			}
+			if(pk > 0.0){
+				isolated = k[2] + k[3] + k[4] + k[5];
+				moved = fspIsolate(moved, isolated);
+				if(isolated > 0 && mode == 0 && sc->escalation != TEST_NONE) moved = fspSetField(moved, FSP_MODE, 5, 1); // escalate from tomorrow
+				t->games += pk * g;
+				t->infectedInGame += pk * g * (fspField(moved, 8*2, 8) + fspField(moved, 8*3, 8) + fspField(moved, 8*5, 8));
+				fspAdd(to, moved, pk);
+			}
+			for(s=2; s<6 && ++k[s] > c[s]; s++) k[s] = 0;
+			if(s == 6) break;
+		}
+	}
+}
+
+// add the replicates that end on day ceaseDay with probability p
+static void fspEnd(FSPTOTAL *t, double p, int infected, int ceaseDay, int massInfection)
+{
+	t->mass += p;
+	t->finalSize += p * infected;
+	t->ceaseDay += p * ceaseDay;
+	t->massInfection += p * massInfection;
+}
+
+// the checks at the end of day d and the symptom check of the next morning, from the states of from into to:
+// the states where the infection ceased and all of them on the last day end, the isolations of the week are
+// checked for mass infection, and the members in Is are isolated in the week of the next day
+static void fspEvening(FSPSTATES *from, FSPSTATES *to, int d, int escalation, const PARAMS *par, FSPTOTAL *t)
+{
+	long i;
+	int week, s, infected, symptomatic;
+	unsigned long long key;
+	double p;
+
+	fspClear(to);
+	for(i=0; i<from->n; i++){
+		if((p = from->p[i]) <= 0.0) continue;
+		key = from->key[i];
+		week = fspField(key, FSP_WEEK, 3);
+		for(infected=0, s=1; s<6; s++) infected += fspField(key, 8*s, 8);
+		if(infected == 0){ // cease infection
+			fspEnd(t, p, par->member - fspField(key, 0, 8), d, week == 6 || (CEASE_ENDS_WEEK && week == 5));
+			continue;
+		}
+		if(d%7 == 6) week = (week >= 5) ? 6 : 0; // end of the week, check for mass infection
+		if(d == 7*par->weeks-1){
+			fspEnd(t, p, par->member - fspField(key, 0, 8), 7*par->weeks, week == 6);
+			continue;
+		}
+
+		// the symptom check, the tests escalate after those of the next day
+		key = fspSetField(key, FSP_WEEK, 3, week);
+		if((symptomatic = fspField(key, 8*4, 8)) > 0){
+			key = fspIsolate(fspSetField(key, 8*4, 8, 0), symptomatic);
+			if(escalation && fspField(key, FSP_MODE, 5) == 0) key = fspSetField(key, FSP_MODE, 5, FSP_PENDING);
+		}
+		fspAdd(to, key, p);
+	}
+}
+
+// 1: the tests of a policy depend on the day of week
+static int fspCalendar(const SCHEDULE *sc)
+{
+	int week, day;
+
+	for(week=0; week<MAX_PERIOD; week++)
+		for(day=1; day<7; day++)
+			if(sc->test[week][day] != sc->test[week][0]) return 1;
+	return 0;
+}
+
+// solve a scenario at the parameters par into t, a and b are the tables of the distribution
+static void solveScenario(int scenario, const PARAMS *par, double tolerance, FSPSTATES *a, FSPSTATES *b, FSPTOTAL *t)
+{
+	const SCHEDULE *sc = &schedules[scenario];
+	int d, calendar, parities, dayBegin, parity;
+	long j;
+	double before, after, rate[STATES];
+
+	gillespieRates(rate, par);
+	memset(t, 0, sizeof(FSPTOTAL));
+
+	// one E, on every day of week and PCR parity the replicate can draw
+	calendar = fspCalendar(sc);
+	parities = (sc->phase < 0) ? 2 : 1;
+	fspClear(a);
+	for(dayBegin=0; dayBegin<(calendar ? 7 : 1); dayBegin++)
+		for(parity=0; parity<parities; parity++)
+			fspAdd(a, fspSetField(fspSetField((unsigned long long)(par->member - 1) | 1ULL << 8, FSP_DAY, 3, dayBegin), FSP_PARITY, 1, parity),
+				1.0 / ((calendar ? 7 : 1) * parities));
+
+	for(d=0; d<7*par->weeks && a->n > 0; d++){
+		fspMorning(a, b, scenario, d, calendar, par, tolerance, t);
+		for(before=0.0, j=0; j<b->n; j++) before += b->p[j];
+		fspLeap(b, rate, par->eta, 1.0, FSP_TAIL * tolerance, FSP_CUT * tolerance);
+		for(after=0.0, j=0; j<b->n; j++) after += b->p[j];
+		t->lost += before - after;
+		fspEvening(b, a, d, sc->escalation != TEST_NONE, par, t);
+	}
+}
+
+// solve every scenario of schedules[] at every point and write its measure items and the probability lost,
+// as the lines of printResults() without a sweep and as CSV rows with one (sw);
+// -1 and prints the reason if a scenario is not a chain of the counts
+int solveMaster(const PARAMS par[], long nPoints, double tolerance, const SWEEP *sw, FILE *fp)
+{
+	const int *items = reportItems, nItems = (int)(sizeof(reportItems)/sizeof(reportItems[0]));
+	const SCHEDULE *sc;
+	int scenario, i, a;
+	long point;
+	double mean[ITEMS];
+	FSPSTATES *from, *to;
+	FSPTOTAL t;
+
+	for(point=0; point<nPoints; point++){
+		if(par[point].member > FSP_MAX_MEMBER){
+			fprintf(stderr, "-F needs MEMBER up to %d\n", FSP_MAX_MEMBER);
+			return -1;
+		}
+	}
+	for(scenario=0; scenario<nScenarios; scenario++){
+		sc = &schedules[scenario];
+		for(i=0; i<MAX_PERIOD*7; i++) if((sc->test[i/7][i%7] == TEST_PCR || sc->test[i/7][i%7] == TEST_ANTIGEN_PCR) && sc->read > 0) break;
+		if(i < MAX_PERIOD*7 || ((sc->escalation == TEST_PCR || sc->escalation == TEST_ANTIGEN_PCR) && sc->escalationRead > 0) || sc->every > FSP_MAX_EVERY){
+			fprintf(stderr, "%s: -F needs tests read at once and escalated tests at least every %d days\n", sc->name, FSP_MAX_EVERY);
+			return -1;
+		}
+	}
+
+	if(sw != NULL){
+		fprintf(fp, "point");
+		for(a=0; a<sw->nAxes; a++) fprintf(fp, ",%s", sw->axis[a].key);
+		fprintf(fp, ",scenario,final_size,cease_day,infected_in_game,mass_infection,lost\n");
+	}
+	from = newStates(1024);
+	to = newStates(1024);
+	for(point=0; point<nPoints; point++){
+		for(scenario=0; scenario<nScenarios; scenario++){
+			solveScenario(scenario, &par[point], tolerance, from, to, &t);
+			mean[0] = t.finalSize / t.mass;
+			mean[1] = t.ceaseDay / t.mass;
+			mean[2] = (t.games > 0.0) ? t.infectedInGame / t.games : 0.0;
+			mean[3] = t.massInfection / t.mass;
+			if(sw != NULL){
+				writeSweepPoint(fp, sw, point);
+				fprintf(fp, ",%d,%g,%g,%g,%g,%g\n", scenario, mean[0], mean[1], mean[2], mean[3], t.lost);
+			} else {
+				fprintf(fp, "%s", schedules[scenario].name);
+				for(i=0; i<nItems; i++) fprintf(fp, " %g", mean[items[i]]);
+				fprintf(fp, " %g\n", t.lost);
+			}
+			fflush(fp);
+		}
+	}
+	freeStates(to);
+	freeStates(from);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*
+   Exact continuous-time engine for the infection process within a day
+   (-e gillespie).
+
+   The per-step probabilities sigma, rho, gamma and beta are rates times
+   the step length delta, so dividing them by delta gives the rates of the continuous-time
+   model. The direct method of Gillespie (1977) jumps from event to event
+   and stops at the end of the day, so the daily symptom check, the tests
+   and the game-day statistics run as before. Members are tracked as
+   cohorts, as in the binomial engine, and identities are assigned at the
+   end of the day.
+*/
+
+#ifndef GILLESPIEENGINE_H
+#define GILLESPIEENGINE_H
+
+#include "binomialEngine.h"
+
+// the rates of the continuous-time model per day, rate[0] per susceptible and infectious individual
+void gillespieRates(double rate[], const PARAMS *par)
+{
+	rate[0] = par->beta / par->delta; // per susceptible and infectious individual
+	rate[1] = par->sigma / par->delta; // E -> P1
+	rate[2] = par->rho / par->delta; // P1 -> P2
+	rate[3] = par->rho / par->delta; // P2 -> Is or Ia
+	rate[4] = par->gamma / par->delta; // Is -> R
+	rate[5] = par->gamma / par->delta; // Ia -> R
+}
+
+// the cohort (q, a) of the member at u, 0 <= u < number[s], counting the members in state s cohort by cohort
+void pickCohort(const COHORTS *c, int s, double u, int *q, int *a)
+{
+	for(*q=0; *q<2; (*q)++){
+		for(*a=0; *a<=s; (*a)++){
+			if(u < (double)c->flow[*q][*a][s]) return;
+			u -= (double)c->flow[*q][*a][s];
+		}
+	}
+	// rounding at the upper end, take the last non-empty cohort
+	for(*q=1; *q>=0; (*q)--) for(*a=s; *a>=0; (*a)--) if(c->flow[*q][*a][s] > 0) return;
+}
+
+// a member of cohort (q, a) moves from state s to next
+static inline void moveCohort(COHORTS *c, int q, int a, int s, int next, int number[], int stateNumber[])
+{
+	c->flow[q][a][s]--;
+	c->flow[q][a][next]++;
+	number[s]--;
+	number[next]++;
+	// change the stateNumber only when this individual is not quarantined
+	if(q == 0){
+		stateNumber[s]--;
+		stateNumber[next]++;
+	}
+}
+
+// the next event of the direct method after time t of the day, returns its time, 1.0 or later when
+// the day is over first (nothing moves then) or nothing can happen; number[s] are the members in state s,
+// quarantined or not, quarantined ones keep progressing
+double gillespieEvent(COHORTS *c, int number[], int stateNumber[], const double rate[], const PARAMS *par, double t)
+{
+	int q, a, s, next;
+	double u, total, propensity[STATES];
+
+	propensity[0] = rate[0] * (double)number[0] * (double)(stateNumber[2] + stateNumber[3] + stateNumber[4] + stateNumber[5]);
+	total = propensity[0];
+	for(s=1; s<6; s++){
+		propensity[s] = rate[s] * (double)number[s];
+		total += propensity[s];
+	}
+	if(total <= 0.0) return 1.0;
+
+	t += -log(urand()) / total; // time to the next event
+	if(t >= 1.0) return t; // the day is over
+
+	// which state the event leaves
+	u = urand() * total;
+	for(s=0; s<5; s++){
+		if(u < propensity[s]) break;
+		u -= propensity[s];
+	}
+	while(propensity[s] == 0.0) s--; // rounding at the upper end
+
+	// which cohort the moving member belongs to
+	pickCohort(c, s, urand() * (double)number[s], &q, &a);
+
+	if(s == 3) next = (urand() < par->eta) ? 4 : 5; // P2 individuals will be either Is or Ia
+	else next = (s < 4) ? s + 1 : 6;
+	moveCohort(c, q, a, s, next, number, stateNumber);
+	return t;
+}
+
+void infections_in_a_day_gillespie(int stateNumber[], INDIV *indiv, const PARAMS *par)
+{
+	int s, number[STATES];
+	double t, rate[STATES];
+	COHORTS c;
+
+	beginCohorts(&c, indiv, par->member);
+
+	// members in each state, quarantined or not, quarantined ones keep progressing
+	for(s=0; s<STATES; s++) number[s] = c.size[0][s] + c.size[1][s];
+	gillespieRates(rate, par);
+
+	for(t=0.0; t<1.0; ) t = gillespieEvent(&c, number, stateNumber, rate, par, t);
+
+	assignCohorts(&c, indiv);
+}
+
+#endif
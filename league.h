@@ -0,0 +1,235 @@
+/*
+   A league of teams (-L teams) in place of one team on its own.
+
+   Every team is a population of par->member players with the daily
+   routine, the tests and the infection process of a team on its own, on
+   the calendar of the league. A replicate starts with one E member in
+   team 0 and every other team susceptible; the other teams are infected
+   in games. On game days (Saturdays) the teams meet along a round robin
+   by the circle method, every team plays every other once in slots-1
+   rounds (one round a week) and the rounds repeat, so 20 teams play a
+   double round robin in the default 38 weeks. With an odd number of
+   teams one team has a bye every round. In a game every susceptible
+   player that plays is infected with probability
+   1 - exp(-game beta oneT infectious), infectious the players of the
+   opponent in P1, P2, Is or Ia who are not isolated: with game = 1 a game
+   is as infectious as a day within the team.
+
+   The teams are independent between two game days, so they advance from
+   one game day to the next (the infection process of the game day, the
+   days of the week and the tests of the next game day) in a dynamically
+   scheduled parallel loop, and synchronize only there: the players of
+   the game are set in the tests of the game day, in a slot per parity of
+   the round that the opponent does not write in the same loop. A team
+   without any member in E, P1, P2, Is or Ia, isolated or not, skips its
+   infection process, nothing can change there until its next game. The
+   draws of a team are keyed by (scenario, replicate, team) with -r
+   philox, so the results do not depend on the threads.
+
+   The league ceases the first day no team has members in E, P1, P2, Is
+   or Ia who are not isolated. The measure items of a replicate are those
+   of the league: the members infected in all teams, the day the league
+   ceases, the infected players per game over all games and the number of
+   teams with a mass infection. -T file writes the same per team, and the
+   members infected in games, as CSV rows.
+*/
+
+#ifndef LEAGUE_H
+#define LEAGUE_H
+
+#include "simulation.h"
+
+#define MAX_TEAMS 65536
+
+// a team of the league, on a cache line of its own so that the threads of different teams do not share one
+typedef struct __attribute__((aligned(64))) team {
+	int stateNumber[STATES];
+	INDIV indiv;
+	REPLICATE r;
+	int playing[2]; // infectious players in the game of an even and an odd round, -1: no game
+	int idleSince; // first day of the stretch with no member in E, P1, P2, Is or Ia who is not isolated, -1: infected
+	int imported; // members infected in games
+} TEAM;
+
+// the sums of a team over the replicates of a point
+typedef struct teamTotal {
+	long long infected; // members infected, within the team and in games
+	long long imported; // members infected in games
+	long long games;
+	long long infectedInGame;
+	long long massInfection;
+} TEAMTOTAL;
+
+typedef struct league {
+	int nTeams;
+	int slots; // nTeams rounded up to even, slot nTeams is the bye of an odd league
+	int dayBegin; // the day of week of day 0, that of team 0
+	TEAM *team;
+	TEAMTOTAL *total; // of (scenario, team), total[scenario*nTeams + team]
+} LEAGUE;
+
+static int leagueTeams = 0; // -L, teams of the league, 0: a team on its own
+
+LEAGUE *newLeague(int nTeams)
+{
+	LEAGUE *lg = malloc(sizeof(LEAGUE));
+
+	lg->nTeams = nTeams;
+	lg->slots = nTeams + (nTeams & 1);
+	lg->team = aligned_alloc(64, nTeams * sizeof(TEAM));
+	lg->total = malloc(nScenarios * nTeams * sizeof(TEAMTOTAL));
+	return lg;
+}
+
+void freeLeague(LEAGUE *lg)
+{
+	free(lg->total);
+	free(lg->team);
+	free(lg);
+}
+
+void clearLeagueTotals(LEAGUE *lg)
+{
+	memset(lg->total, 0, nScenarios * lg->nTeams * sizeof(TEAMTOTAL));
+}
+
+// the round of the game on day d, the number of game days before it
+static inline int leagueRound(const LEAGUE *lg, int d)
+{
+	return (lg->dayBegin + d)/7 - (lg->dayBegin != 0);
+}
+
+// the first game day after day d, or last + 1
+static inline int nextGameDay(const LEAGUE *lg, int d, int last)
+{
+	int next = d + 7 - (lg->dayBegin + d)%7;
+
+	return (next <= last) ? next : last + 1;
+}
+
+// the opponent of a team in a round, -1: a bye; slot m = slots-1 stays and the others turn,
+// team i < m meets (2k - i) mod m in round k, or slot m when that is i itself
+int leagueOpponent(const LEAGUE *lg, int team, int round)
+{
+	int m = lg->slots - 1, k = round % m, other;
+
+	if(team == m) other = k;
+	else {
+		other = ((2*k - team) % m + m) % m;
+		if(other == team) other = m;
+	}
+	return (other < lg->nTeams) ? other : -1;
+}
+
+// the teams at the start of replicate rep, all susceptible but member 0 of team 0, on the calendar of team 0
+void startLeague(LEAGUE *lg, int scenario, int rep, const PARAMS *par)
+{
+	int team;
+	TEAM *t;
+
+	for(team=0; team<lg->nTeams; team++){
+		t = &lg->team[team];
+		rngReplicate(scenario, rep);
+		rngTeam(team);
+		beginReplicate(&t->r, t->stateNumber, &t->indiv, par);
+		if(team > 0){ // no E of its own, the team is infected in games
+			moveMember(&t->indiv, 0, 0);
+			t->stateNumber[1]--;
+			t->stateNumber[0]++;
+		}
+		t->r.dayBegin = lg->team[0].r.dayBegin;
+		t->playing[0] = t->playing[1] = -1;
+		t->idleSince = -1;
+		t->imported = 0;
+	}
+	lg->dayBegin = lg->team[0].r.dayBegin;
+}
+
+// 1: a member of the team is in E, P1, P2, Is or Ia, the infection process can change the team
+static inline int teamActive(const TEAM *t, int n)
+{
+	int w;
+
+	if(t->stateNumber[1] > 0) return 1; // E members are never isolated
+	for(w=0; 64*w<n; w++) if(t->indiv.infected[w]) return 1;
+	return 0;
+}
+
+// the susceptible players of a team infected in a game against infectious players of the opponent
+void gameInfections(TEAM *t, int infectious, const PARAMS *par)
+{
+	int member;
+	double p;
+
+	if(infectious <= 0) return;
+	p = 1.0 - exp(-par->game * par->beta * par->oneT * infectious);
+	rngAt(STEP_GAME, 0);
+	for(member=0; member<par->member; member++){
+		if(t->indiv.state[member] != 0) continue; // susceptible members are never isolated
+		if(urand() < p){
+			moveMember(&t->indiv, member, 1);
+			t->stateNumber[0]--;
+			t->stateNumber[1]++;
+			t->imported++;
+		}
+	}
+}
+
+// add the measure items of the league and of every team at the end of a replicate, the league ceased on ceaseDay
+void endLeague(LEAGUE *lg, int scenario, int ceaseDay, const PARAMS *par, RESULT *total)
+{
+	int team, infected = 0, games = 0, infectedInGame = 0, massInfection = 0;
+	double x[VALUES];
+	TEAM *t;
+	TEAMTOTAL *tt;
+
+	for(team=0; team<lg->nTeams; team++){
+		t = &lg->team[team];
+		tt = &lg->total[scenario*lg->nTeams + team];
+		tt->infected += par->member - t->stateNumber[0];
+		tt->imported += t->imported;
+		tt->games += t->r.gameCount;
+		tt->infectedInGame += t->r.infectedInGame;
+		tt->massInfection += t->r.massInfection;
+		infected += par->member - t->stateNumber[0];
+		games += t->r.gameCount;
+		infectedInGame += t->r.infectedInGame;
+		massInfection += t->r.massInfection;
+	}
+	total->numInfects += infected;
+	total->dayInfectionCease += ceaseDay;
+	total->gameCount += games;
+	total->infectedInGame += infectedInGame;
+	total->massInfection += massInfection;
+
+	x[0] = infected;
+	x[1] = ceaseDay;
+	x[2] = infectedInGame;
+	x[3] = massInfection;
+	x[VALUE_GAMES] = games;
+	addValues(&total->stat, x);
+}
+
+void writeTeamHeader(FILE *fp)
+{
+	fprintf(fp, "point,scenario,team,replicates,final_size,imported,infected_in_game,mass_infection\n");
+	fflush(fp);
+}
+
+// the means of every (scenario, team) over the reps replicates of a point
+void writeTeamRows(FILE *fp, const LEAGUE *lg, long point, int reps)
+{
+	int s, team;
+	const TEAMTOTAL *tt;
+
+	for(s=0; s<nScenarios; s++){
+		for(team=0; team<lg->nTeams; team++){
+			tt = &lg->total[s*lg->nTeams + team];
+			fprintf(fp, "%ld,%d,%d,%d,%g,%g,%g,%g\n", point, s, team, reps, (double)tt->infected/reps, (double)tt->imported/reps,
+				(tt->games > 0) ? (double)tt->infectedInGame/tt->games : 0.0, (double)tt->massInfection/reps);
+		}
+	}
+	fflush(fp);
+}
+
+#endif
@@ -0,0 +1,366 @@
+/*
+   Definitions shared by regularTesting.c, addTesting.c and the
+   alternative infection engines.
+*/
+
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "MTstream.h"
+#include "philox.h"
+#include "stats.h"
+
+#define MEMBER 50 // default population size, set at run time by PARAMS.member
+#ifndef MAX_MEMBER
+#define MAX_MEMBER 256 // largest population size, the length of the member arrays
+#endif
+#define STATES 8 // 0: S, 1: E, 2: P1, 3: P2, 4: Is, 5: Ia, 6: R, 7: quarantined
+#define ONE_T 100
+#define DELTA 0.01
+#define WEEKS 38 // simulation length in weeks
+#define SCENARIOS 6 // number of testing scenarios of a program
+#define MAX_SCENARIOS 64 // scenarios of a run, the policies of a schedule file (-t)
+#define ALL_SCENARIOS -1 // the scenario of a chunk that runs every scenario in lockstep
+#ifndef REPS
+#define REPS 10000 // replicates per scenario
+#endif
+#ifndef REPS_PER_CHUNK
+#define REPS_PER_CHUNK 100 // replicates drawn from one generator stream
+#endif
+
+// engines for the infection process within a day, chosen by -e
+#define ENGINE_MEMBER 0 // one Bernoulli trial per member per ONE_T step
+#define ENGINE_BINOMIAL 1 // binomial number of transitions per state per ONE_T step
+#define ENGINE_GILLESPIE 2 // exact event-driven simulation in continuous time
+#define ENGINE_WHEEL 3 // geometric sojourn times drawn on entry, kept in a timer wheel
+#define ENGINE_SIMD 4 // LANES replicates in lockstep, one per SIMD lane
+#define ENGINE_TAU 5 // continuous time in adaptive leaps of Poisson numbers of transitions
+
+// random number generators, chosen by -r
+#define RNG_MT 0 // sequential MT19937-64 streams, one per chunk of replicates
+#define RNG_PHILOX 1 // Philox4x32-10 keyed by (scenario, replicate, day, step, member)
+
+// steps of a day that are not ONE_T steps, for the counter of RNG_PHILOX
+#define STEP_ENGINE 0x10000 // sequential draws of the infection engines
+#define STEP_TEST 0x10001 // tests, one point per member
+#define STEP_INIT 0x10002 // initialization of a replicate
+#define STEP_SIMD 0x10003 // seeds of the SIMD lane generators
+#define STEP_FAST 0x10004 // fast-forward through a quiescent period
+#define STEP_GAME 0x10005 // infections in a game between two teams of a league
+
+// variance reduction, chosen by -v (see variance.h)
+#define VR_ANTITHETIC 1 // replicates in pairs, the second draws 1-u for every u of the first
+#define VR_CONTROL 2 // scenario 0 as a control variate for the other scenarios
+
+static int rngMode = RNG_MT;
+static int fastForward = 0; // 1: skip the quiescent periods of a replicate (-f)
+static int varianceMode = 0; // VR_ANTITHETIC | VR_CONTROL, 0: plain Monte Carlo
+static int commonNumbers = 0; // 1: replicate r of every scenario draws the same random numbers
+static int nScenarios = SCENARIOS; // scenarios of the run, SCENARIOS or the policies of -t
+static int lockstep = 0; // 1: the scenarios of a replicate run together and fork where they diverge (-l)
+
+#include "profile.h"
+
+// generator stream of this thread, set for every chunk of replicates
+static _Thread_local MT64 *currentStream;
+
+// coordinates of the next RNG_PHILOX draw on this thread
+static _Thread_local struct rngPoint {
+	unsigned int key[2]; // scenario, replicate
+	unsigned int ctr[4]; // member or other index, step, day, block of two draws
+	int spare; // 1: the second draw of the last block is not used yet
+	double spareDraw;
+	unsigned int flip; // ~0u: antithetic draws 1-u, 0: plain draws
+} rngPoint;
+
+static int streamsMade = 0; // streams of setRandomSeed() made so far, the others are made on first use
+
+// one stream per chunk, the results do not depend on the number of threads; only stream 0 is made
+// here, the jumps ahead to the others are left to randomStream()
+void setRandomSeed(MT64 streams[])
+{
+	mt64_init(&streams[0], 1);
+	streamsMade = 1;
+}
+
+// stream k of setRandomSeed(), made with those before it on first use: stream k is stream k-1
+// jumped ahead, the same as mt64_streams(), so the jumps of one thread spread over the run
+// instead of holding up its start
+MT64 *randomStream(MT64 streams[], int k)
+{
+#ifdef _OPENMP
+	#pragma omp critical(randomStream)
+#endif
+	for(; streamsMade <= k; streamsMade++){
+		streams[streamsMade] = streams[streamsMade-1];
+		mt64_jump(&streams[streamsMade]);
+	}
+	return &streams[k];
+}
+
+// the replicate of the following draws, starts at STEP_INIT
+static inline void rngReplicate(int scenario, int rep)
+{
+	rngPoint.key[0] = commonNumbers ? 0u : (unsigned int)scenario;
+	rngPoint.key[1] = (unsigned int)rep;
+	rngPoint.ctr[0] = 0;
+	rngPoint.ctr[1] = STEP_INIT;
+	rngPoint.ctr[2] = 0;
+	rngPoint.ctr[3] = 0;
+	rngPoint.spare = 0;
+}
+
+// the team of a league (league.h) of the following draws, after rngReplicate(); team 0 draws as a team on its own
+static inline void rngTeam(int team)
+{
+	rngPoint.key[0] += (unsigned int)team * MAX_SCENARIOS;
+}
+
+// 1: the following replicates draw 1-u instead of u, on both generators
+static inline void rngAntithetic(int on)
+{
+	rngPoint.flip = on ? ~0u : 0u;
+}
+
+// the day (0: the first E arises) and the step of the following draws
+static inline void rngDay(int d)
+{
+	rngPoint.ctr[0] = 0;
+	rngPoint.ctr[1] = STEP_ENGINE;
+	rngPoint.ctr[2] = (unsigned int)d + 1; // 0 is the initialization
+	rngPoint.ctr[3] = 0;
+	rngPoint.spare = 0;
+}
+
+// the step and the member (or other index) of the following draws on the same day
+static inline void rngAt(int step, int index)
+{
+	rngPoint.ctr[0] = (unsigned int)index;
+	rngPoint.ctr[1] = (unsigned int)step;
+	rngPoint.ctr[3] = 0;
+	rngPoint.spare = 0;
+}
+
+// rename genrand64_real3 to urand
+static inline double urand()
+{
+	unsigned int out[4];
+	double u;
+
+	PROFILE_DRAWS(1);
+	if(rngMode == RNG_MT){
+		u = mt64_real3(currentStream);
+		return rngPoint.flip ? 1.0 - u : u; // exact, u is (k + 0.5) / 2^52
+	}
+
+	if(rngPoint.spare){
+		rngPoint.spare = 0;
+		return rngPoint.spareDraw;
+	}
+	philox4x32(rngPoint.ctr, rngPoint.key, out);
+	rngPoint.ctr[3]++;
+	rngPoint.spare = 1;
+	rngPoint.spareDraw = philoxReal(out[2] ^ rngPoint.flip, out[3] ^ rngPoint.flip);
+	return philoxReal(out[0] ^ rngPoint.flip, out[1] ^ rngPoint.flip);
+}
+
+// the first two RNG_PHILOX draws at (step, index) of the current day for index = 0,..., n-1,
+// philox4x32() on 16 counters side by side so that the rounds vectorize
+static inline void urandBlock(int step, int n, double block[][2])
+{
+	int i, j, round, m;
+	unsigned int c0[16], c1[16], c2[16], c3[16], k0, k1;
+	unsigned long long p0, p1;
+
+	PROFILE_DRAWS(2 * n);
+	for(i=0; i<n; i+=16){
+		m = (n - i < 16) ? n - i : 16;
+		for(j=0; j<16; j++){
+			c0[j] = (unsigned int)(i + j);
+			c1[j] = (unsigned int)step;
+			c2[j] = rngPoint.ctr[2];
+			c3[j] = 0;
+		}
+		k0 = rngPoint.key[0];
+		k1 = rngPoint.key[1];
+		for(round=0; round<10; round++){
+			for(j=0; j<16; j++){
+				p0 = (unsigned long long)PHILOX_M0 * c0[j];
+				p1 = (unsigned long long)PHILOX_M1 * c2[j];
+				c0[j] = (unsigned int)(p1 >> 32) ^ c1[j] ^ k0;
+				c2[j] = (unsigned int)(p0 >> 32) ^ c3[j] ^ k1;
+				c1[j] = (unsigned int)p1;
+				c3[j] = (unsigned int)p0;
+			}
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+		for(j=0; j<m; j++){
+			block[i+j][0] = philoxReal(c0[j] ^ rngPoint.flip, c1[j] ^ rngPoint.flip);
+			block[i+j][1] = philoxReal(c2[j] ^ rngPoint.flip, c3[j] ^ rngPoint.flip);
+		}
+	}
+}
+
+// Loops over the members are written as kernels with the population size n
+// as their first argument. SPECIALIZE_MEMBER inlines one copy of a kernel
+// for each common team size, where n is a constant and the member loops can
+// be unrolled and vectorized, and a generic copy for any other size.
+#define KERNEL static inline __attribute__((always_inline))
+#define SPECIALIZE_MEMBER(n, kernel, ...) do{ \
+	switch(n){ \
+	  case 16: kernel(16, __VA_ARGS__); break; \
+	  case 25: kernel(25, __VA_ARGS__); break; \
+	  case 32: kernel(32, __VA_ARGS__); break; \
+	  case 50: kernel(50, __VA_ARGS__); break; \
+	  case 64: kernel(64, __VA_ARGS__); break; \
+	  case 128: kernel(128, __VA_ARGS__); break; \
+	  default: kernel(n, __VA_ARGS__); break; \
+	} \
+}while(0)
+
+#define WORDS ((MAX_MEMBER + 63) / 64) // 64-bit words of a set of members
+#define DUE_DAYS 16 // ring of pending PCR results by the day they are read, the longest read time
+
+// the population of a replicate, per-member flags are bit sets with member m at bit m%64 of word m/64
+typedef struct indiv {
+	unsigned long long quarantine[WORDS]; //0: in the population, 1: quarantined
+	unsigned long long testResult[WORDS]; // 1: the PCR test is positive, an antigen positive is quarantined at once
+	unsigned long long infected[WORDS]; // P1, P2, Is or Ia, the only states a test detects
+	unsigned long long symptomatic[WORDS]; // Is
+	unsigned long long due[DUE_DAYS][WORDS]; // waiting for the PCR result read on day d, in due[d % DUE_DAYS]
+	unsigned char state[64*WORDS]; //epidemic states
+} INDIV;
+
+static inline int testBit(const unsigned long long bits[], int m)
+{
+	return (int)((bits[m >> 6] >> (m & 63)) & 1);
+}
+
+static inline void setBit(unsigned long long bits[], int m)
+{
+	bits[m >> 6] |= 1ULL << (m & 63);
+}
+
+// members 64w,..., 64w+63 that are in a population of n
+static inline unsigned long long memberWord(int n, int w)
+{
+	return (n >= 64*(w+1)) ? ~0ULL : (n <= 64*w) ? 0ULL : (1ULL << (n - 64*w)) - 1;
+}
+
+// change the state of a member, every engine goes through here so that infected and symptomatic stay up to date
+static inline void moveMember(INDIV *indiv, int member, int next)
+{
+	int w = member >> 6;
+	unsigned long long bit = 1ULL << (member & 63);
+
+	indiv->state[member] = (unsigned char)next;
+	indiv->infected[w] = (indiv->infected[w] & ~bit) | (-(unsigned long long)(next >= 2 && next <= 5) & bit);
+	indiv->symptomatic[w] = (indiv->symptomatic[w] & ~bit) | (-(unsigned long long)(next == 4) & bit);
+}
+
+// lowest member of a word of bits, the word must not be 0
+#define LOWEST(bits) __builtin_ctzll(bits)
+#define POPCOUNT(bits) __builtin_popcountll(bits)
+
+// parameters of a run, the defaults are set in main() and a sweep (-s) changes them point by point
+typedef struct params {
+	int member; // population size, 1,..., MAX_MEMBER
+	double R0; // basic reproductive ratio
+	int oneT; // steps per day
+	double delta; // length of a step in days, 1/oneT
+	int readTime; // days until the results of regular PCR tests are read
+	int weeks; // simulation length
+	double latent; // average duration as E in days, sw for wild type, so for omicron
+	double eta; // probability that P2 becomes Is
+	double game; // contact in a game between two teams of a league relative to a day within a team (league.h)
+	double tauError; // relative change of the states allowed in a leap of ENGINE_TAU (tauEngine.h)
+	int reps; // replicates per scenario, the cap with a precision, scenario 0 runs BASELINE_REPS times as many with VR_CONTROL
+	double precision; // relative half-width of the confidence intervals to stop at (-p), 0: run all reps
+	double PCRSTV[STATES]; // sensitivity of the PCR test by state
+	double antigen[MAX_SCENARIOS]; // sensitivity of the antigen test relative to PCR, by scenario
+	double antigenProfile[MAX_SCENARIOS][STATES]; // by scenario and state, times antigen[], 1: the profile of PCR
+	
+	// set by deriveParams()
+	double beta, gamma, rho, sigma;
+	double antigenSTV[MAX_SCENARIOS][STATES];
+} PARAMS;
+
+// per-step probabilities and antigen sensitivities from the parameters above, whole antithetic pairs
+void deriveParams(PARAMS *p)
+{
+	int scenario, i;
+	
+	if(varianceMode & VR_ANTITHETIC) p->reps += p->reps & 1;
+	p->sigma = p->delta * 1.0 / p->latent; // rate from E(1) to P1
+	p->rho = p->delta * 1.0 / 1.0; //Ia1 and Ia2 last 1 day
+	p->gamma = p->delta * 1.0 / 7.0; // recovery in 7 days
+	p->beta = 1.0 / (double)p->member * p->delta * p->R0 / 9.0; // frequency dependent
+	for(scenario=0; scenario<nScenarios; scenario++)
+		for(i=0; i<STATES; i++) p->antigenSTV[scenario][i] = p->antigen[scenario] * p->antigenProfile[scenario][i] * p->PCRSTV[i];
+}
+
+typedef struct result {
+	int numInfects; // number of infected individuals
+	int dayInfectionCease; // days until no infected individuals remain in the population
+	int gameCount; // number of games played
+	int infectedInGame; // infected individuals (P1, P2, Is, Ia) who played a game
+	int massInfection; // replicates with more than 4 isolations in a week
+	STATS stat; // the same per replicate, for the standard errors
+	PAIRSTATS pair; // samples with their scenario 0 twins, for -v
+} RESULT;
+
+void clearResult(RESULT *total)
+{
+	total->numInfects = total->dayInfectionCease = total->gameCount = total->infectedInGame = total->massInfection = 0;
+	clearStats(&total->stat);
+	clearPairs(&total->pair);
+}
+
+// total += t, the replicates of t follow those of total
+void addResult(RESULT *total, const RESULT *t)
+{
+	total->numInfects += t->numInfects;
+	total->dayInfectionCease += t->dayInfectionCease;
+	total->gameCount += t->gameCount;
+	total->infectedInGame += t->infectedInGame;
+	total->massInfection += t->massInfection;
+	mergeStats(&total->stat, &t->stat);
+	mergePairs(&total->pair, &t->pair);
+}
+
+// the measure items, from the exact sums
+void itemMeans(const RESULT *total, double mean[ITEMS])
+{
+	mean[0] = (double)total->numInfects/total->stat.n;
+	mean[1] = (double)total->dayInfectionCease/total->stat.n;
+	mean[2] = (total->gameCount > 0) ? (double)total->infectedInGame/(double)total->gameCount : 0.0; // no game, a team of a league with only byes
+	mean[3] = (double)total->massInfection/total->stat.n;
+}
+
+// engine number from its name on the command line, -1 if unknown
+int engineByName(const char *name)
+{
+	if(strcmp(name, "member") == 0) return ENGINE_MEMBER;
+	if(strcmp(name, "binomial") == 0) return ENGINE_BINOMIAL;
+	if(strcmp(name, "gillespie") == 0) return ENGINE_GILLESPIE;
+	if(strcmp(name, "wheel") == 0) return ENGINE_WHEEL;
+	if(strcmp(name, "simd") == 0) return ENGINE_SIMD;
+	if(strcmp(name, "tau") == 0) return ENGINE_TAU;
+	return -1;
+}
+
+// generator number from its name on the command line, -1 if unknown
+int rngByName(const char *name)
+{
+	if(strcmp(name, "mt") == 0) return RNG_MT;
+	if(strcmp(name, "philox") == 0) return RNG_PHILOX;
+	return -1;
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+   Transmission along a contact network (-n file) instead of mass action,
+   for the member engine.
+
+   The file lists the contacts of the population, one undirected edge per
+   line with an optional weight, the intensity of the contact (default 1):
+
+     # position groups, a shared room
+     0 1
+     0 2 0.5
+     1 2 2
+
+   The members are the nodes 0,..., n-1, n the largest node + 1, and the
+   network sets the population size (MEMBER). The first E of a replicate
+   is node 0. The contacts are kept in CSR form (offset, adj, weight) with
+   both directions of every edge.
+
+   A susceptible member is infected in a step with probability
+   netBeta * (the sum of the weights of its neighbours in P1, P2, Is or Ia
+   who are not isolated), netBeta = delta R_0 / (9 mean weighted degree),
+   so that R_0 keeps the meaning it has under mass action, which is the
+   complete network of weight 1 up to n-1 for n.
+
+   The sums are kept per thread (netSums) for the set of members they
+   count. At every step the set is compared with the members who are
+   infectious and not isolated now, word by word, and only the neighbours
+   of the members that entered or left it are updated: the cost of a step
+   is that of the changes since the last step (the engine, the tests, the
+   isolations), not that of the edges. Since the sums follow any set, they
+   stay right when a thread moves to another replicate, branch (-l) or
+   team (-L). The weights are fixed point integers, NET_ONE per unit, so
+   the sums are exact whatever the order of the updates.
+*/
+
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include "model.h"
+
+#define NET_ONE 65536 // fixed point unit of the weights
+#define NET_MAX_WEIGHT 32767.0 // largest weight of an edge
+
+typedef struct network {
+	int n; // members, the nodes 0,..., n-1
+	int *offset; // the neighbours of m are adj[offset[m]],..., adj[offset[m+1]-1]
+	int *adj;
+	int *weight; // of the edge to adj[i], NET_ONE per unit
+	double meanDegree; // sum of the weights of a member, mean over the members, NET_ONE per unit
+} NETWORK;
+
+static NETWORK *network = NULL; // -n, NULL: mass action
+
+// the infectious-neighbour sums of this thread
+static _Thread_local struct netSums {
+	long long sum[MAX_MEMBER]; // weights of the neighbours of m in the set below
+	unsigned long long counted[WORDS]; // the set of members counted in sum[]
+} netSums;
+
+// read a network from a file, NULL and prints the reason on an error
+NETWORK *readNetwork(const char *fileName)
+{
+	FILE *fp;
+	char line[1024], *p, *end;
+	int lineNumber = 0, nEdges = 0, maxEdges = 1024, i, j, m, k, *from, *to, *units, *fill;
+	double w, total;
+	NETWORK *net;
+
+	fp = fopen(fileName, "r");
+	if(fp == NULL){
+		fprintf(stderr, "%s: cannot open\n", fileName);
+		return NULL;
+	}
+	from = malloc(maxEdges * sizeof(int));
+	to = malloc(maxEdges * sizeof(int));
+	units = malloc(maxEdges * sizeof(int));
+	net = malloc(sizeof(NETWORK));
+	net->n = 0;
+	while(fgets(line, sizeof(line), fp) != NULL){
+		lineNumber++;
+		if((p = strchr(line, '#')) != NULL) *p = '\0';
+		for(p = line; *p == ' ' || *p == '\t'; p++);
+		if(*p == '\0' || *p == '\n' || *p == '\r') continue; // blank line
+
+		i = (int)strtol(p, &end, 10);
+		if(end == p) goto bad;
+		p = end;
+		j = (int)strtol(p, &end, 10);
+		if(end == p) goto bad;
+		p = end;
+		w = strtod(p, &end);
+		if(end == p) w = 1.0; // no weight
+		for(p = end; *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'; p++);
+		if(*p != '\0' || i < 0 || j < 0 || i >= MAX_MEMBER || j >= MAX_MEMBER || i == j || !(w > 0.0 && w <= NET_MAX_WEIGHT)) goto bad;
+
+		if(nEdges == maxEdges){
+			maxEdges *= 2;
+			from = realloc(from, maxEdges * sizeof(int));
+			to = realloc(to, maxEdges * sizeof(int));
+			units = realloc(units, maxEdges * sizeof(int));
+		}
+		from[nEdges] = i;
+		to[nEdges] = j;
+		units[nEdges] = (int)(w * NET_ONE + 0.5);
+		if(units[nEdges] < 1) units[nEdges] = 1;
+		nEdges++;
+		if(i >= net->n) net->n = i + 1;
+		if(j >= net->n) net->n = j + 1;
+	}
+	fclose(fp);
+	if(nEdges == 0){
+		fprintf(stderr, "%s: no contact\n", fileName);
+		goto fail;
+	}
+
+	// CSR with both directions, the edges of a member in the order of the file
+	net->offset = calloc(net->n + 1, sizeof(int));
+	net->adj = malloc(2 * nEdges * sizeof(int));
+	net->weight = malloc(2 * nEdges * sizeof(int));
+	fill = malloc(net->n * sizeof(int));
+	for(k=0; k<nEdges; k++){
+		net->offset[from[k] + 1]++;
+		net->offset[to[k] + 1]++;
+	}
+	for(m=0; m<net->n; m++){
+		net->offset[m+1] += net->offset[m];
+		fill[m] = net->offset[m];
+	}
+	total = 0.0;
+	for(k=0; k<nEdges; k++){
+		net->adj[fill[from[k]]] = to[k];
+		net->weight[fill[from[k]]++] = units[k];
+		net->adj[fill[to[k]]] = from[k];
+		net->weight[fill[to[k]]++] = units[k];
+		total += 2.0 * units[k];
+	}
+	net->meanDegree = total / net->n;
+	free(fill);
+	free(units);
+	free(to);
+	free(from);
+	return net;
+
+  bad:
+	fprintf(stderr, "%s:%d: bad contact line, see network.h\n", fileName, lineNumber);
+	fclose(fp);
+  fail:
+	free(units);
+	free(to);
+	free(from);
+	free(net);
+	return NULL;
+}
+
+// add sign times the weights of member to the sums of its neighbours
+static inline void countMember(const NETWORK *net, int member, int sign)
+{
+	int i;
+
+	for(i=net->offset[member]; i<net->offset[member+1]; i++) netSums.sum[net->adj[i]] += sign * (long long)net->weight[i];
+}
+
+// bring the sums of this thread to the members of a population of n who are infectious and not isolated,
+// visiting only the members that entered or left that set since the last call
+static inline void updateNetSums(const NETWORK *net, const INDIV *indiv, int n)
+{
+	int w;
+	unsigned long long now, bits;
+
+	for(w=0; 64*w<n; w++){
+		now = indiv->infected[w] & ~indiv->quarantine[w];
+		for(bits = now & ~netSums.counted[w]; bits; bits &= bits-1) countMember(net, 64*w + LOWEST(bits), 1);
+		for(bits = netSums.counted[w] & ~now; bits; bits &= bits-1) countMember(net, 64*w + LOWEST(bits), -1);
+		netSums.counted[w] = now;
+	}
+}
+
+#endif
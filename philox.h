@@ -0,0 +1,46 @@
+/*
+   Philox4x32-10 counter-based random number generator of
+     J. K. Salmon, M. A. Moraes, R. O. Dror, D. E. Shaw,
+     ``Parallel random numbers: as easy as 1, 2, 3''
+     Proceedings of SC11 (2011).
+
+   The output is a pure function of a 128-bit counter and a 64-bit key, so
+   any draw can be computed directly from its coordinates, in any order.
+*/
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u // golden ratio
+#define PHILOX_W1 0xBB67AE85u // sqrt(3)-1
+
+// out = philox4x32_10(ctr, key)
+static inline void philox4x32(const unsigned int ctr[4], const unsigned int key[2], unsigned int out[4])
+{
+	int round;
+	unsigned int c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3], k0 = key[0], k1 = key[1];
+	unsigned long long p0, p1;
+
+	for(round=0; round<10; round++){
+		p0 = (unsigned long long)PHILOX_M0 * c0;
+		p1 = (unsigned long long)PHILOX_M1 * c2;
+		c0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0;
+		c2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1;
+		c1 = (unsigned int)p1;
+		c3 = (unsigned int)p0;
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+	out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+// random real on (0,1) from 64 random bits, the same mapping as genrand64_real3()
+static inline double philoxReal(unsigned int lo, unsigned int hi)
+{
+	unsigned long long x = ((unsigned long long)hi << 32) | lo;
+	return ((x >> 12) + 0.5) * (1.0/4503599627370496.0);
+}
+
+#endif
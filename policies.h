@@ -0,0 +1,76 @@
+/*
+   Testing policies, the part of the daily routine that differs between
+   the scenarios of the programs.
+
+   A program describes its scenarios in scenarioTests(scenario, ...), a
+   KERNEL made of the policies below, and program.h inlines one copy of it
+   for every scenario with SPECIALIZE_SCENARIO, so the scenario and the
+   arguments of the policies are constants and their branches fold away.
+   The daily symptom check before the tests and the game statistics after
+   them are the same for every scenario and stay in program.h.
+*/
+
+#ifndef POLICIES_H
+#define POLICIES_H
+
+#include "simulation.h"
+
+// tests of the policies
+#define TEST_ANTIGEN 0 // antigen test, isolated at once
+#define TEST_PCR 1 // PCR test read later, the next day in reactiveTests()
+#define TEST_PCR_ZERO_READ 2 // PCR test read at once
+#define TEST_ANTIGEN_PCR 3 // antigen test, the positives confirmed by PCR (schedule.h)
+#define TEST_NONE 4 // no test (schedule.h)
+
+// PCR tests of everybody on Fridays, read par->readTime days later; every other week
+// (the weeks of the parity r->lastPCR) when biweekly
+KERNEL void regularPCR(int biweekly, REPLICATE *r, int d, int whatDay, int stateNumber[], INDIV *indiv, const PARAMS *par)
+{
+	// see the results of PCR testing
+	disclosurePCRresult(par->member, stateNumber, indiv, d);
+
+	if(whatDay == 6){ // if it is Friday today,
+		if(!biweekly || (d/7)%2 == r->lastPCR){ // and if no PCR testing last week
+			doTest(par->member, indiv, par->PCRSTV, d + par->readTime);
+		}
+	}
+}
+
+// antigen tests of everybody on Tuesdays and Fridays
+KERNEL void twiceWeeklyAntigen(int whatDay, int stateNumber[], INDIV *indiv, const double antigenSTV[], const PARAMS *par)
+{
+	if(whatDay == 3 || whatDay == 6){ // if it is Tuesday or Friday
+		doAntigenTest(par->member, stateNumber, indiv, antigenSTV);
+	}
+}
+
+// twice weekly antigen tests until somebody is isolated, then the test every day,
+// or every other day when everyOtherDay
+KERNEL void reactiveTests(int test, int everyOtherDay, REPLICATE *r, int d, int whatDay, int stateNumber[], INDIV *indiv, const double antigenSTV[], const PARAMS *par)
+{
+	if(test == TEST_PCR) disclosurePCRresult(par->member, stateNumber, indiv, d);
+
+	if(r->testMode == 0){
+		twiceWeeklyAntigen(whatDay, stateNumber, indiv, antigenSTV, par);
+	} else {// test mode, go into additional test
+		if(!everyOtherDay || r->addTestDays%2 == 0){
+			switch(test){
+			  case TEST_ANTIGEN:
+				doAntigenTest(par->member, stateNumber, indiv, antigenSTV);
+				break;
+			  case TEST_PCR:
+				doTest(par->member, indiv, par->PCRSTV, d + 1); // read the next day
+				break;
+			  case TEST_PCR_ZERO_READ:
+				doPCRtestWithZeroReadTime(par->member, stateNumber, indiv, par->PCRSTV);
+				break;
+			}
+		}
+		r->addTestDays++;
+	} // end choice of test mode
+
+	// if quarantined person arise, change test mode
+	if(stateNumber[7] > 0) r->testMode = 1; // stateNumber[7] never returns to 0
+}
+
+#endif
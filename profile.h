@@ -0,0 +1,201 @@
+/*
+   Phase profiling of the replicates, compiled in with -DPROFILE and to
+   nothing without it.
+
+   The daily routine is split into the phases below. Every switch of phase
+   reads the cycle counter (the TSC on x86, the monotonic clock in ns
+   elsewhere) and charges the cycles since the last switch to the phase
+   and the scenario running, and urand() counts its draws to them, so the
+   time and the random numbers of a run can be told apart by phase. With
+   -l the shared work of a branch counts for the first scenario of the
+   branch. The lengths of the replicates, the days until the infection
+   ceases (dayInfectionCease), go into a histogram by week.
+
+   The counters are per thread and added to the totals after every chunk.
+   At the end of the run the summary goes to stderr, and -P file writes it
+   as a Chrome trace (chrome://tracing, Perfetto), one track per scenario
+   with the phases side by side as long as their share of the run.
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#ifdef PROFILE
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define PHASES 6
+#define PHASE_DAY 0 // the rest of the daily routine: setup, games, end of week checks, forks of -l
+#define PHASE_INFECTION 1 // infections_in_a_day() on the chosen engine
+#define PHASE_SKIP 2 // the quiescent periods of -f
+#define PHASE_SYMPTOM 3 // dailySymptomCheck()
+#define PHASE_DISCLOSURE 4 // disclosurePCRresult()
+#define PHASE_TEST 5 // the tests of the policies
+#define PROFILE_WEEKS 64 // bins of the histogram of replicate lengths, the last takes the longer ones
+
+static const char *phaseName[PHASES] = {"day", "infection", "skip", "symptom", "disclosure", "test"};
+
+typedef struct profileCounts {
+	unsigned long long cycles[MAX_SCENARIOS][PHASES];
+	unsigned long long draws[MAX_SCENARIOS][PHASES];
+	unsigned long long weeks[MAX_SCENARIOS][PROFILE_WEEKS]; // replicates by length in weeks
+} PROFILECOUNTS;
+
+static PROFILECOUNTS profileTotal; // of the run
+static _Thread_local PROFILECOUNTS profileCounts; // of this thread since its last flush
+static _Thread_local struct profileNow {
+	int running; // 0: between chunks, nothing is charged
+	int scenario, phase;
+	unsigned long long stamp; // cycle counter at the last switch
+} profileNow;
+static unsigned long long profileStartCycles;
+static struct timespec profileStartTime;
+
+static inline unsigned long long profileClock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (unsigned long long)t.tv_sec * 1000000000ULL + (unsigned long long)t.tv_nsec;
+#endif
+}
+
+// charge the cycles since the last switch and go on in phase
+static inline void profileSwitch(int phase)
+{
+	unsigned long long now = profileClock();
+
+	if(profileNow.running) profileCounts.cycles[profileNow.scenario][profileNow.phase] += now - profileNow.stamp;
+	profileNow.stamp = now;
+	profileNow.phase = phase;
+}
+
+// the daily routine of scenario goes on
+static inline void profileScenario(int scenario)
+{
+	profileSwitch(PHASE_DAY);
+	profileNow.scenario = scenario;
+	profileNow.running = 1;
+}
+
+static inline void profileReplicateEnd(int scenario, int days)
+{
+	int week = days / 7;
+
+	profileCounts.weeks[scenario][(week < PROFILE_WEEKS) ? week : PROFILE_WEEKS - 1]++;
+}
+
+// add the counters of this thread to the totals, after a chunk
+static void profileFlush(void)
+{
+	int s, i;
+
+	profileSwitch(PHASE_DAY);
+	profileNow.running = 0;
+#ifdef _OPENMP
+	#pragma omp critical(profile)
+#endif
+	for(s=0; s<MAX_SCENARIOS; s++){
+		for(i=0; i<PHASES; i++){
+			profileTotal.cycles[s][i] += profileCounts.cycles[s][i];
+			profileTotal.draws[s][i] += profileCounts.draws[s][i];
+		}
+		for(i=0; i<PROFILE_WEEKS; i++) profileTotal.weeks[s][i] += profileCounts.weeks[s][i];
+	}
+	memset(&profileCounts, 0, sizeof(PROFILECOUNTS));
+}
+
+static void profileStart(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &profileStartTime);
+	profileStartCycles = profileClock();
+}
+
+// the summary on stderr, and the Chrome trace to traceName unless NULL
+static void profileReport(const char *traceName)
+{
+	int s, i, comma;
+	unsigned long long all = 0, scenarioCycles, draws;
+	double seconds, perSecond, ts;
+	struct timespec end;
+	FILE *fp;
+
+	profileFlush();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	seconds = (end.tv_sec - profileStartTime.tv_sec) + 1e-9 * (end.tv_nsec - profileStartTime.tv_nsec);
+	perSecond = (seconds > 0.0) ? (profileClock() - profileStartCycles) / seconds : 1e9; // cycles per wall second
+	for(s=0; s<nScenarios; s++) for(i=0; i<PHASES; i++) all += profileTotal.cycles[s][i];
+
+	fprintf(stderr, "profile: %.3g cycles in the replicates, %.3g s of wall time at %.3g cycles/s\n", (double)all, seconds, perSecond);
+	fprintf(stderr, "scenario phase cycles share draws\n");
+	for(s=0; s<nScenarios; s++){
+		for(i=0; i<PHASES; i++){
+			if(profileTotal.cycles[s][i] == 0 && profileTotal.draws[s][i] == 0) continue;
+			fprintf(stderr, "%d %s %.4g %.4f %llu\n", s, phaseName[i], (double)profileTotal.cycles[s][i],
+				(all > 0) ? (double)profileTotal.cycles[s][i] / all : 0.0, profileTotal.draws[s][i]);
+		}
+	}
+	fprintf(stderr, "scenario replicates by length in weeks, week:count\n");
+	for(s=0; s<nScenarios; s++){
+		fprintf(stderr, "%d", s);
+		for(i=0; i<PROFILE_WEEKS; i++) if(profileTotal.weeks[s][i] > 0) fprintf(stderr, " %d:%llu", i, profileTotal.weeks[s][i]);
+		fprintf(stderr, "\n");
+	}
+
+	if(traceName == NULL) return;
+	fp = fopen(traceName, "w");
+	if(fp == NULL){
+		fprintf(stderr, "%s: cannot open\n", traceName);
+		return;
+	}
+	fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	comma = 0;
+	for(s=0; s<nScenarios; s++){
+		fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": {\"name\": \"scenario %d\"}}", comma ? ",\n" : "", s, s);
+		comma = 1;
+		ts = 0.0;
+		scenarioCycles = 0;
+		draws = 0;
+		for(i=0; i<PHASES; i++){
+			if(profileTotal.cycles[s][i] == 0) continue;
+			fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"cycles\": %llu, \"draws\": %llu}}",
+				phaseName[i], s, ts, 1e6 * profileTotal.cycles[s][i] / perSecond, profileTotal.cycles[s][i], profileTotal.draws[s][i]);
+			ts += 1e6 * profileTotal.cycles[s][i] / perSecond;
+			scenarioCycles += profileTotal.cycles[s][i];
+			draws += profileTotal.draws[s][i];
+		}
+		fprintf(fp, ",\n{\"name\": \"scenario %d\", \"ph\": \"C\", \"pid\": 0, \"tid\": %d, \"ts\": 0, \"args\": {\"cycles\": %llu, \"draws\": %llu}}", s, s, scenarioCycles, draws);
+	}
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+}
+
+#define PROFILE_PHASE(phase) profileSwitch(phase)
+#define PROFILE_SCENARIO(scenario) profileScenario(scenario)
+#define PROFILE_DRAWS(n) (profileCounts.draws[profileNow.scenario][profileNow.phase] += (n))
+#define PROFILE_REPLICATE_END(scenario, days) profileReplicateEnd(scenario, days)
+#define PROFILE_FLUSH() profileFlush()
+#define PROFILE_START() profileStart()
+#define PROFILE_REPORT(traceName) profileReport(traceName)
+#define PROFILE_COMPILED 1
+
+#else
+
+#define PROFILE_PHASE(phase) ((void)0)
+#define PROFILE_SCENARIO(scenario) ((void)0)
+#define PROFILE_DRAWS(n) ((void)0)
+#define PROFILE_REPLICATE_END(scenario, days) ((void)0)
+#define PROFILE_FLUSH() ((void)0)
+#define PROFILE_START() ((void)0)
+#define PROFILE_REPORT(traceName) ((void)(traceName))
+#define PROFILE_COMPILED 0 // -P has nothing to write
+
+#endif
+
+#endif
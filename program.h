@@ -0,0 +1,698 @@
+/*
+   The replicate loops and main() shared by regularTesting.c and
+   addTesting.c. A program includes this file after its testing policy:
+
+     scenarioTests(scenario, r, d, whatDay, stateNumber, indiv, par)
+         the tests of day d, a KERNEL made of the policies of policies.h
+     setAntigenSensitivity(antigen)
+         the antigen sensitivity relative to PCR of every scenario
+     LATENT            the default duration as E in days
+     CEASE_ENDS_WEEK   1: the day the infection ceases is checked for
+                       mass infection as the end of a week
+     reportItems[]     the measure items printed, see stats.h
+
+   With -t file the policies of the file (schedule.h) are the scenarios
+   instead of those of scenarioTests, and with -L teams the replicates
+   are leagues of teams (league.h). With -F the measure items of the
+   policies of -t are solved for without replicates (fsp.h).
+*/
+
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include "policies.h"
+#include "schedule.h"
+#include "sweep.h"
+#include "bench.h"
+#include "league.h"
+#include "fsp.h"
+
+// one copy of a testing policy kernel for every scenario, the scenario is a constant in each
+#define SPECIALIZE_SCENARIO(scenario, kernel, ...) do{ \
+	switch(scenario){ \
+	  case 0: kernel(0, __VA_ARGS__); break; \
+	  case 1: kernel(1, __VA_ARGS__); break; \
+	  case 2: kernel(2, __VA_ARGS__); break; \
+	  case 3: kernel(3, __VA_ARGS__); break; \
+	  case 4: kernel(4, __VA_ARGS__); break; \
+	  case 5: kernel(5, __VA_ARGS__); break; \
+	} \
+}while(0)
+
+// the symptom check and the tests of day d of the week whatDay
+void dailyTests(REPLICATE *r, int scenario, int d, int whatDay, int stateNumber[], INDIV *indiv, const PARAMS *par)
+{
+	// daily symptom check
+	dailySymptomCheck(par->member, stateNumber, indiv);
+	
+	// folk by the testing scenario
+	if(schedules != NULL) scheduleTests(scenario, r, d, whatDay, stateNumber, indiv, par);
+	else SPECIALIZE_SCENARIO(scenario, scenarioTests, r, d, whatDay, stateNumber, indiv, par);
+}
+
+// the daily routine before the infection process of day d (d = 0 is the day the first E arises)
+void beforeInfection(REPLICATE *r, int scenario, int d, int stateNumber[], INDIV *indiv, const PARAMS *par)
+{
+	int whatDay;
+	
+	//What day is it today?
+	whatDay = (r->dayBegin + d)%7; //0: Saturday, 1: Sunday,..., 6: Friday
+	
+	dailyTests(r, scenario, d, whatDay, stateNumber, indiv, par);
+	
+	// some for statistics
+	if(whatDay == 0){
+		//play a game
+		r->gameCount++;
+		r->infectedInGame += (stateNumber[2] + stateNumber[3] + stateNumber[4] + stateNumber[5]);
+	}
+}
+
+// the checks after the infection process of day d, returns 1 when the infection ceased that day
+int dayChecks(REPLICATE *r, int d, const int stateNumber[])
+{
+	if(stateNumber[1] + stateNumber[2] + stateNumber[3] + stateNumber[4] + stateNumber[5] == 0){
+		// cease infection
+		r->dayInfectionCease = d;
+		r->bp=1; // if there are no infected individuals, quit simulation
+		if(CEASE_ENDS_WEEK) weeklyCheck(r, stateNumber); // the week ends with the infection
+		return 1;
+	}
+	
+	if(d%7 == 6) weeklyCheck(r, stateNumber); // end of the week, check for mass infection
+	return 0;
+}
+
+// the checks after the infection process of day d, returns 1 when the replicate is over
+int afterInfection(REPLICATE *r, int d, int stateNumber[], const PARAMS *par)
+{
+	return dayChecks(r, d, stateNumber) || d == 7*par->weeks-1; // simulation length is par->weeks weeks
+}
+
+// run one replicate and add its measure items to total
+void runReplicate(int scenario, int engine, int rep, int stateNumber[], INDIV *indiv, const PARAMS *par, RESULT *total)
+{
+	int d, firstStep;
+	REPLICATE r;
+	
+	PROFILE_SCENARIO(scenario);
+	rngReplicate(scenario, rep);
+	beginReplicate(&r, stateNumber, indiv, par);
+	if(engine == ENGINE_WHEEL) startTimerWheel();
+	
+	for(d=0; ; d++){
+		rngDay(d);
+		beforeInfection(&r, scenario, d, stateNumber, indiv, par);
+		
+		// proceed infection for one day, from the first step that is not skipped
+		PROFILE_PHASE(PHASE_SKIP);
+		firstStep = (fastForward && (engine == ENGINE_MEMBER || engine == ENGINE_BINOMIAL)) ? skipQuiescent(&r.quiet, d, stateNumber, indiv, par) : 0;
+		PROFILE_PHASE(PHASE_INFECTION);
+		rngAt(STEP_ENGINE, 0);
+		if(firstStep < par->oneT) switch(engine){
+		  case ENGINE_MEMBER:
+			infections_in_a_day(stateNumber, indiv, par, firstStep);
+			break;
+		  case ENGINE_BINOMIAL:
+			infections_in_a_day_binomial(stateNumber, indiv, par, firstStep);
+			break;
+		  case ENGINE_GILLESPIE:
+			infections_in_a_day_gillespie(stateNumber, indiv, par);
+			break;
+		  case ENGINE_TAU:
+			infections_in_a_day_tau(stateNumber, indiv, par);
+			break;
+		  case ENGINE_WHEEL:
+			infections_in_a_day_wheel(stateNumber, indiv, par);
+			break;
+		}
+		PROFILE_PHASE(PHASE_DAY);
+		
+		if(afterInfection(&r, d, stateNumber, par)) break;
+	}
+	
+	PROFILE_REPLICATE_END(scenario, r.dayInfectionCease);
+	endReplicate(&r, stateNumber, par, total);
+}
+
+// run replicates firstRep,..., firstRep+nReps-1 in lockstep on the SIMD engine and add their
+// measure items to total, a lane whose replicate is over starts the next one
+void runBatch(int scenario, int firstRep, int nReps, const PARAMS *par, RESULT *total)
+{
+	int lane, started, running;
+	int d[LANES], rep[LANES], active[LANES], stateNumber[LANES][STATES];
+	INDIV indiv[LANES];
+	REPLICATE r[LANES];
+	SIMDRNG g;
+	
+	PROFILE_SCENARIO(scenario);
+	started = 0;
+	for(lane=0; lane<LANES; lane++){
+		active[lane] = (started < nReps);
+		if(active[lane]){
+			rep[lane] = firstRep + started++;
+			rngReplicate(scenario, rep[lane]);
+			beginReplicate(&r[lane], stateNumber[lane], &indiv[lane], par);
+			if(rngMode == RNG_PHILOX) seedSimdLane(&g, lane);
+			d[lane] = 0;
+		}
+	}
+	if(rngMode == RNG_MT) seedSimdRng(&g);
+	
+	for(running=started; running > 0; ){
+		for(lane=0; lane<LANES; lane++){
+			if(!active[lane]) continue;
+			rngReplicate(scenario, rep[lane]);
+			rngDay(d[lane]);
+			beforeInfection(&r[lane], scenario, d[lane], stateNumber[lane], &indiv[lane], par);
+		}
+		
+		// proceed infection for one day in all lanes
+		PROFILE_PHASE(PHASE_INFECTION);
+		infections_in_a_day_simd(stateNumber, indiv, active, &g, par);
+		PROFILE_PHASE(PHASE_DAY);
+		
+		for(lane=0; lane<LANES; lane++){
+			if(!active[lane]) continue;
+			if(afterInfection(&r[lane], d[lane]++, stateNumber[lane], par)){
+				PROFILE_REPLICATE_END(scenario, r[lane].dayInfectionCease);
+				endReplicate(&r[lane], stateNumber[lane], par, total);
+				if(started < nReps){ // refill the lane
+					rep[lane] = firstRep + started++;
+					rngReplicate(scenario, rep[lane]);
+					beginReplicate(&r[lane], stateNumber[lane], &indiv[lane], par);
+					if(rngMode == RNG_PHILOX) seedSimdLane(&g, lane);
+					d[lane] = 0;
+				} else {
+					active[lane] = 0; // no replicates left, mask out the lane
+					running--;
+				}
+			}
+		}
+	}
+}
+
+
+// a trajectory of one replicate shared by the scenarios whose daily routines agree so far
+typedef struct branch {
+	unsigned long long scenarios; // bit s: scenario s follows the branch
+	int over; // 1: the replicate is over on this branch
+	int from; // the branch it forked from
+	int stateNumber[STATES];
+	REPLICATE r;
+	INDIV indiv;
+} BRANCH;
+
+// 1: two branches are in the same state
+static int sameBranch(const BRANCH *a, const BRANCH *b)
+{
+	return memcmp(a->stateNumber, b->stateNumber, sizeof(a->stateNumber)) == 0
+		&& memcmp(&a->r, &b->r, sizeof(REPLICATE)) == 0 && memcmp(&a->indiv, &b->indiv, sizeof(INDIV)) == 0;
+}
+
+// run replicates firstRep,..., firstRep+nReps-1 of all scenarios together and add the measure items of
+// scenario s to total[s]; a replicate starts as one branch followed by every scenario, and every day
+// the scenarios whose routine leaves another state than the first scenario of their branch fork into
+// new branches, so the infection process runs once per branch instead of once per scenario.
+// The scenarios draw the same random numbers (commonNumbers), a branch is exactly the replicate
+// that runReplicate() gives for each of its scenarios.
+void runForked(int engine, int firstRep, int nReps, const PARAMS *par, RESULT total[])
+{
+	int rep, d, b, k, s, first, nb, last, running, firstStep;
+	BRANCH *br, start, trial;
+	TIMERWHEEL *wheels; // timers of each branch for ENGINE_WHEEL
+	
+	br = malloc(nScenarios * sizeof(BRANCH));
+	wheels = (engine == ENGINE_WHEEL) ? malloc(nScenarios * sizeof(TIMERWHEEL)) : NULL;
+	for(rep=firstRep; rep<firstRep+nReps; rep++){
+		memset(&br[0], 0, sizeof(BRANCH)); // no stray bytes for sameBranch()
+		PROFILE_SCENARIO(0);
+		rngReplicate(0, rep);
+		beginReplicate(&br[0].r, br[0].stateNumber, &br[0].indiv, par);
+		br[0].scenarios = ~0ULL >> (64 - nScenarios);
+		if(engine == ENGINE_WHEEL){
+			startTimerWheel();
+			wheels[0] = wheel;
+		}
+		nb = running = 1;
+		
+		for(d=0; running > 0; d++){
+			// the daily routine of every scenario, fork where it differs from the first scenario of the branch
+			for(b=0, last=nb; b<last; b++){
+				if(br[b].over) continue;
+				start = br[b];
+				first = LOWEST(br[b].scenarios);
+				PROFILE_SCENARIO(first);
+				rngDay(d);
+				beforeInfection(&br[b].r, first, d, br[b].stateNumber, &br[b].indiv, par);
+				for(s=first+1; s<nScenarios; s++){
+					if(!((br[b].scenarios >> s) & 1)) continue;
+					trial = start;
+					PROFILE_SCENARIO(s);
+					rngDay(d);
+					beforeInfection(&trial.r, s, d, trial.stateNumber, &trial.indiv, par);
+					if(sameBranch(&trial, &br[b])) continue;
+					
+					// join a branch forked from b today in the same state, or fork a new one
+					br[b].scenarios &= ~(1ULL << s);
+					for(k=last; k<nb; k++) if(br[k].from == b && sameBranch(&trial, &br[k])) break;
+					if(k < nb) br[k].scenarios |= 1ULL << s;
+					else {
+						br[nb] = trial;
+						br[nb].scenarios = 1ULL << s;
+						br[nb].from = b;
+						if(engine == ENGINE_WHEEL) wheels[nb] = wheels[b];
+						nb++;
+						running++;
+					}
+				}
+			}
+			
+			// proceed infection for one day on every branch
+			for(b=0; b<nb; b++){
+				if(br[b].over) continue;
+				if(engine == ENGINE_WHEEL) wheel = wheels[b];
+				PROFILE_SCENARIO(LOWEST(br[b].scenarios));
+				PROFILE_PHASE(PHASE_SKIP);
+				firstStep = (fastForward && (engine == ENGINE_MEMBER || engine == ENGINE_BINOMIAL)) ? skipQuiescent(&br[b].r.quiet, d, br[b].stateNumber, &br[b].indiv, par) : 0;
+				PROFILE_PHASE(PHASE_INFECTION);
+				rngAt(STEP_ENGINE, 0);
+				if(firstStep < par->oneT) switch(engine){
+				  case ENGINE_MEMBER:
+					infections_in_a_day(br[b].stateNumber, &br[b].indiv, par, firstStep);
+					break;
+				  case ENGINE_BINOMIAL:
+					infections_in_a_day_binomial(br[b].stateNumber, &br[b].indiv, par, firstStep);
+					break;
+				  case ENGINE_GILLESPIE:
+					infections_in_a_day_gillespie(br[b].stateNumber, &br[b].indiv, par);
+					break;
+				  case ENGINE_TAU:
+					infections_in_a_day_tau(br[b].stateNumber, &br[b].indiv, par);
+					break;
+				  case ENGINE_WHEEL:
+					infections_in_a_day_wheel(br[b].stateNumber, &br[b].indiv, par);
+					break;
+				}
+				if(engine == ENGINE_WHEEL) wheels[b] = wheel;
+				PROFILE_PHASE(PHASE_DAY);
+				
+				if(afterInfection(&br[b].r, d, br[b].stateNumber, par)){
+					br[b].over = 1;
+					running--;
+					for(s=0; s<nScenarios; s++)
+						if((br[b].scenarios >> s) & 1){
+							PROFILE_REPLICATE_END(s, br[b].r.dayInfectionCease);
+							endReplicate(&br[b].r, br[b].stateNumber, par, &total[s]);
+						}
+				}
+			}
+		}
+	}
+	free(wheels);
+	free(br);
+}
+
+// run replicates firstRep,..., firstRep+nReps-1 of a scenario on the chosen engine, a CHUNKFUNC,
+// of ALL_SCENARIOS with total[] for every scenario
+void runChunk(int scenario, int engine, int firstRep, int nReps, const PARAMS *par, RESULT *total)
+{
+	int rep, stateNumber[STATES];
+	INDIV indiv;
+	
+	if(scenario == ALL_SCENARIOS) runForked(engine, firstRep, nReps, par, total);
+	else if(engine == ENGINE_SIMD) runBatch(scenario, firstRep, nReps, par, total);
+	else for(rep=0; rep<nReps; rep++)
+		runReplicate(scenario, engine, firstRep + rep, stateNumber, &indiv, par, total);
+}
+
+// the days of a team of a league from the infection process of day from to the tests of day to,
+// from = -1: the tests of day 0
+static void leagueDays(LEAGUE *lg, int team, int scenario, int engine, int rep, int from, int to, int last, const PARAMS *par)
+{
+	TEAM *t = &lg->team[team];
+	int d, whatDay, round;
+	
+	PROFILE_SCENARIO(scenario);
+	rngReplicate(scenario, rep);
+	rngTeam(team);
+	for(d=from; d<to; d++){
+		if(d >= 0){
+			// the game of the day, then proceed infection for one day
+			rngDay(d);
+			round = leagueRound(lg, d);
+			if((lg->dayBegin + d)%7 == 0 && t->playing[round & 1] >= 0) gameInfections(t, lg->team[leagueOpponent(lg, team, round)].playing[round & 1], par);
+			PROFILE_PHASE(PHASE_INFECTION);
+			rngAt(STEP_ENGINE, 0);
+			if(teamActive(t, par->member)) switch(engine){
+			  case ENGINE_MEMBER:
+				infections_in_a_day(t->stateNumber, &t->indiv, par, 0);
+				break;
+			  case ENGINE_BINOMIAL:
+				infections_in_a_day_binomial(t->stateNumber, &t->indiv, par, 0);
+				break;
+			  case ENGINE_GILLESPIE:
+				infections_in_a_day_gillespie(t->stateNumber, &t->indiv, par);
+				break;
+			  case ENGINE_TAU:
+				infections_in_a_day_tau(t->stateNumber, &t->indiv, par);
+				break;
+			}
+			PROFILE_PHASE(PHASE_DAY);
+			
+			// the checks of a team on its own, none while it stays ceased
+			if(t->idleSince < 0 || t->stateNumber[1] + t->stateNumber[2] + t->stateNumber[3] + t->stateNumber[4] + t->stateNumber[5] > 0)
+				t->idleSince = dayChecks(&t->r, d, t->stateNumber) ? d : -1;
+		}
+		if(d+1 > last) break;
+		
+		// the tests of the next day, and the players of its game
+		rngDay(d+1);
+		whatDay = (lg->dayBegin + d+1)%7;
+		dailyTests(&t->r, scenario, d+1, whatDay, t->stateNumber, &t->indiv, par);
+		if(whatDay == 0){
+			round = leagueRound(lg, d+1);
+			t->playing[round & 1] = -1;
+			if(leagueOpponent(lg, team, round) >= 0){
+				t->playing[round & 1] = t->stateNumber[2] + t->stateNumber[3] + t->stateNumber[4] + t->stateNumber[5];
+				t->r.gameCount++;
+				t->r.infectedInGame += t->playing[round & 1];
+			}
+		}
+	}
+	PROFILE_FLUSH();
+}
+
+// run replicate rep of a scenario on a league and add its measure items to total; the teams advance in
+// parallel from one game day to the next and meet only in the games, see league.h
+void runLeague(LEAGUE *lg, int scenario, int engine, int rep, const PARAMS *par, RESULT *total)
+{
+	int team, d, next, last = 7*par->weeks - 1, infected, ceaseDay = -1;
+	TEAM *t;
+	
+	startLeague(lg, scenario, rep, par);
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic)
+#endif
+	for(team=0; team<lg->nTeams; team++) leagueDays(lg, team, scenario, engine, rep, -1, 0, last, par);
+	
+	for(d=0; d<=last && ceaseDay < 0; d=next){
+		next = nextGameDay(lg, d, last);
+		infected = 0;
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic) reduction(+:infected)
+#endif
+		for(team=0; team<lg->nTeams; team++){
+			leagueDays(lg, team, scenario, engine, rep, d, next, last, par);
+			infected += (lg->team[team].idleSince < 0);
+		}
+		
+		// cease infection, on the last day a team had infected members; the game of day next is not played
+		if(infected == 0) for(team=0; team<lg->nTeams; team++){
+			t = &lg->team[team];
+			if(t->idleSince > ceaseDay) ceaseDay = t->idleSince;
+			if(next <= last && t->playing[leagueRound(lg, next) & 1] >= 0) t->r.gameCount--;
+		}
+	}
+	if(ceaseDay < 0) ceaseDay = 7*par->weeks; // infection did not cease within the simulation length
+	
+	PROFILE_REPLICATE_END(scenario, ceaseDay);
+	endLeague(lg, scenario, ceaseDay, par, total);
+}
+
+// run every point on a league of leagueTeams teams and report it, the replicates one after the other;
+// the rows of every team to teamName unless NULL, returns -1 if it cannot be written
+int runLeagues(const PARAMS par[], long nPoints, int engine, REPORTFUNC report, void *context, const char *teamName)
+{
+	LEAGUE *lg;
+	FILE *fp = NULL;
+	RESULT total[MAX_SCENARIOS];
+	long point;
+	int s, rep;
+	
+	if(teamName != NULL){
+		fp = fopen(teamName, "w");
+		if(fp == NULL){
+			fprintf(stderr, "%s: cannot open\n", teamName);
+			return -1;
+		}
+		writeTeamHeader(fp);
+	}
+	lg = newLeague(leagueTeams);
+	for(point=0; point<nPoints; point++){
+		clearLeagueTotals(lg);
+		for(s=0; s<nScenarios; s++){
+			clearResult(&total[s]);
+			for(rep=0; rep<par[point].reps; rep++) runLeague(lg, s, engine, rep, &par[point], &total[s]);
+		}
+		report(context, point, &par[point], total);
+		if(fp != NULL) writeTeamRows(fp, lg, point, par[point].reps);
+	}
+	freeLeague(lg);
+	if(fp != NULL) fclose(fp);
+	return 0;
+}
+
+// the measure items of every scenario, a REPORTFUNC
+void printResults(void *context, long point, const PARAMS *par, RESULT total[])
+{
+	const int *items = reportItems, nItems = (int)(sizeof(reportItems)/sizeof(reportItems[0]));
+	int scenario, i;
+	double mean[ITEMS], se, reduced[6];
+	
+	(void)context; // stdout
+	(void)point; // the defaults of the program, the only point without -s
+	for(scenario = 0; scenario < nScenarios; scenario++){
+		itemMeans(&total[scenario], mean);
+		if(schedules != NULL) printf("%s ", schedules[scenario].name);
+		if(varianceMode){ // estimate, standard error and variance-reduction factor of every item and of its difference from scenario 0
+			printf("%ld", total[scenario].stat.n);
+			for(i=0; i<nItems; i++){
+				if(items[i] == ITEM_IN_GAME) continue; // a ratio, see variance.h
+				reducedEstimate(total, scenario, items[i], reduced);
+				printf(" %g %g %g %g %g %g", reduced[0], reduced[1], reduced[2], reduced[3], reduced[4], reduced[5]);
+			}
+			printf("\n");
+		} else if(par->precision <= 0.0){
+			for(i=0; i<nItems; i++) printf((i == 0) ? "%g" : " %g", mean[items[i]]);
+			printf("\n");
+		}
+		else { // replicates, then mean, standard error and confidence interval of every item
+			printf("%ld", total[scenario].stat.n);
+			for(i=0; i<nItems; i++){
+				se = standardError(&total[scenario].stat, items[i]);
+				printf(" %g %g %g %g", mean[items[i]], se, mean[items[i]] - CONFIDENCE_Z*se, mean[items[i]] + CONFIDENCE_Z*se);
+			}
+			printf("\n");
+		}
+	}
+}
+
+int main(int argc, char *argv[]){
+	int i, j, engine, singleScenario, singleRep, bench, status;
+	long point, nPoints;
+	double precision, tolerance;
+	const char *specName, *outName, *scheduleName, *traceName, *checkpointFile, *teamName, *networkName;
+	PARAMS base, *par;
+	RESULT total;
+	SWEEP sweep;
+	CSVOUT out;
+	MT64 *streams;
+	
+	engine = ENGINE_MEMBER;
+	singleScenario = 0;
+	singleRep = -1; // -1: run all replicates
+	bench = 0;
+	specName = outName = scheduleName = traceName = checkpointFile = teamName = networkName = NULL;
+	precision = 0.0; // run all reps
+	tolerance = 0.0; // replicates, no master equation
+	for(i=1; i<argc; i++){
+		if(strcmp(argv[i], "-e") == 0 && i+1 < argc) engine = engineByName(argv[++i]);
+		else if(strcmp(argv[i], "-r") == 0 && i+1 < argc) rngMode = rngByName(argv[++i]);
+		else if(strcmp(argv[i], "-x") == 0 && i+2 < argc){
+			singleScenario = atoi(argv[++i]);
+			singleRep = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-s") == 0 && i+1 < argc) specName = argv[++i];
+		else if(strcmp(argv[i], "-o") == 0 && i+1 < argc) outName = argv[++i];
+		else if(strcmp(argv[i], "-t") == 0 && i+1 < argc) scheduleName = argv[++i];
+		else if(strcmp(argv[i], "-f") == 0) fastForward = 1;
+		else if(strcmp(argv[i], "-p") == 0 && i+1 < argc) precision = atof(argv[++i]);
+		else if(strcmp(argv[i], "-v") == 0 && i+1 < argc) varianceMode = varianceByName(argv[++i]);
+		else if(strcmp(argv[i], "-l") == 0) lockstep = 1;
+		else if(strcmp(argv[i], "-P") == 0 && i+1 < argc) traceName = argv[++i];
+		else if(strcmp(argv[i], "-b") == 0) bench = 1;
+		else if(strcmp(argv[i], "-c") == 0 && i+1 < argc) checkpointFile = argv[++i];
+		else if(strcmp(argv[i], "-S") == 0 && i+1 < argc){
+			if(sscanf(argv[++i], "%d/%d", &shardIndex, &shardCount) != 2 || shardCount < 1 || shardIndex < 0 || shardIndex >= shardCount) engine = -1;
+		} else if(strcmp(argv[i], "-m") == 0 && i+1 < argc){
+			if(mergeNames == NULL) mergeNames = malloc(argc * sizeof(char *));
+			mergeNames[nMerge++] = argv[++i];
+		} else if(strcmp(argv[i], "-L") == 0 && i+1 < argc){
+			leagueTeams = atoi(argv[++i]);
+			if(leagueTeams < 1 || leagueTeams > MAX_TEAMS) engine = -1;
+		} else if(strcmp(argv[i], "-T") == 0 && i+1 < argc) teamName = argv[++i];
+		else if(strcmp(argv[i], "-n") == 0 && i+1 < argc) networkName = argv[++i];
+		else if(strcmp(argv[i], "-F") == 0 && i+1 < argc){
+			tolerance = atof(argv[++i]);
+			if(!(tolerance > 0.0 && tolerance < 1.0)) engine = -1;
+		} else engine = -1;
+		if(engine < 0 || rngMode < 0 || precision < 0.0 || varianceMode < 0 || (varianceMode && engine == ENGINE_SIMD) || (lockstep && (varianceMode || engine == ENGINE_SIMD)) || (singleRep >= 0 && (rngMode != RNG_PHILOX || singleScenario < 0))){
+			fprintf(stderr, "usage: %s [-e member|binomial|gillespie|wheel|simd|tau] [-r mt|philox] [-x scenario replicate] [-s spec [-o out.csv]] [-t policies] [-f] [-p precision] [-v antithetic|control|both] [-l] [-P trace.json] [-b [-o out.json]] [-c checkpoint [-S shard/shards]] [-m shard.file ...] [-L teams [-T teams.csv]] [-n network] [-F tolerance]\n", argv[0]);
+			fprintf(stderr, "  -e tau leaps the exact process of gillespie within a tolerance tau_error (see tauEngine.h)\n");
+			fprintf(stderr, "  -x regenerates one replicate on its own and needs -r philox\n");
+			fprintf(stderr, "  -s runs every point of a parameter grid and writes CSV rows (see sweep.h)\n");
+			fprintf(stderr, "  -t runs the testing policies of a file as the scenarios, on common random numbers (see schedule.h)\n");
+			fprintf(stderr, "  -f skips the quiescent periods of the member and binomial engines (see fastForward.h)\n");
+			fprintf(stderr, "  -p runs replicates until the 95%% confidence intervals are within a relative precision, reps is the cap (see stats.h)\n");
+			fprintf(stderr, "  -v estimates with antithetic pairs and/or scenario 0 as a control variate, not with simd (see variance.h)\n");
+			fprintf(stderr, "  -l runs the scenarios of a replicate together until their tests make them differ, not with -v or simd\n");
+			fprintf(stderr, "  -P writes the phase profile as a Chrome trace, in builds with -DPROFILE (see profile.h)\n");
+			fprintf(stderr, "  -b runs the benchmarks instead of the simulation and writes JSON (see bench.h)\n");
+			fprintf(stderr, "  -c saves the chunks done to a file and resumes from it when run again (see checkpoint.h)\n");
+			fprintf(stderr, "  -S runs shard i of N into the file of -c, -m merges the files of all shards and reports (see checkpoint.h)\n");
+			fprintf(stderr, "  -L runs leagues of teams that meet in games, -T writes the results of every team (see league.h)\n");
+			fprintf(stderr, "  -n infects along the contacts of a network file instead of by mass action (see network.h)\n");
+			fprintf(stderr, "  -F solves the master equation of the policies of -t to a tolerance instead of running replicates (see fsp.h)\n");
+			return 1;
+		}
+	}
+	if(traceName != NULL && !PROFILE_COMPILED){
+		fprintf(stderr, "%s: -P needs a build with -DPROFILE, profiling is not compiled in\n", argv[0]);
+		return 1;
+	}
+	if(networkName != NULL && (engine != ENGINE_MEMBER || bench)){
+		fprintf(stderr, "%s: -n needs the member engine and runs without -b\n", argv[0]);
+		return 1;
+	}
+	if((leagueTeams > 0 && (rngMode != RNG_PHILOX || engine == ENGINE_WHEEL || engine == ENGINE_SIMD || fastForward || precision > 0.0 || varianceMode || lockstep || singleRep >= 0 || bench || checkpointFile != NULL || nMerge > 0))
+		|| (teamName != NULL && leagueTeams == 0)){
+		fprintf(stderr, "%s: -L needs -r philox and the member, binomial, gillespie or tau engine, and runs without -f, -p, -v, -l, -x, -b, -c or -m; -T needs -L\n", argv[0]);
+		return 1;
+	}
+	if(tolerance > 0.0 && (scheduleName == NULL || fastForward || precision > 0.0 || varianceMode || lockstep || singleRep >= 0 || bench
+		|| checkpointFile != NULL || nMerge > 0 || leagueTeams > 0 || networkName != NULL)){
+		fprintf(stderr, "%s: -F needs -t and runs without -f, -p, -v, -l, -x, -b, -c, -m, -L or -n\n", argv[0]);
+		return 1;
+	}
+	if(shardCount > 1 && (checkpointFile == NULL || precision > 0.0 || nMerge > 0 || singleRep >= 0 || bench)){
+		fprintf(stderr, "%s: -S needs -c and runs without -p, -m, -x or -b\n", argv[0]);
+		return 1;
+	}
+	
+	// the policies of -t in place of the scenarios of the program
+	if(scheduleName != NULL){
+		if((nScenarios = readSchedules(scheduleName)) < 0) return 1;
+	}
+	if(networkName != NULL && (network = readNetwork(networkName)) == NULL) return 1;
+	if(singleRep >= 0 && singleScenario >= nScenarios){
+		fprintf(stderr, "%s: -x scenario out of 0,..., %d\n", argv[0], nScenarios - 1);
+		return 1;
+	}
+	
+	// twins of scenario 0, branches or policies compared on the same random numbers
+	commonNumbers = (varianceMode & VR_CONTROL) || lockstep || schedules != NULL;
+	
+	// parameters
+	
+	memset(&base, 0, sizeof(PARAMS)); // no stray bytes for the fingerprint of checkpoint.h
+	base.member = (network != NULL) ? network->n : MEMBER; // the nodes of a network
+	base.R0 = R_0;
+	base.oneT = ONE_T;
+	base.delta = DELTA;
+	base.readTime = REG_READ_TIME;
+	base.weeks = WEEKS;
+	base.latent = LATENT; // average duration as E
+	base.eta = 0.54;
+	base.game = 1.0;
+	base.tauError = 0.03;
+	base.reps = REPS;
+	base.precision = precision;
+	
+	//set sensitivity of the PCR testing
+	setPCRSensitivity(base.PCRSTV);
+	setAntigenSensitivity(base.antigen);
+	for(i=0; i<MAX_SCENARIOS; i++)
+		for(j=0; j<STATES; j++) base.antigenProfile[i][j] = (schedules != NULL && i<nScenarios) ? schedules[i].profile[j] : 1.0;
+	for(i=0; schedules != NULL && i<nScenarios; i++) base.antigen[i] = schedules[i].sensitivity;
+	deriveParams(&base);
+	
+	if(bench){ // the benchmarks on the defaults of the program
+		out.fp = (outName != NULL) ? fopen(outName, "w") : stdout;
+		if(out.fp == NULL){
+			fprintf(stderr, "%s: cannot open\n", outName);
+			return 1;
+		}
+		runBenchmarks(out.fp, (strrchr(argv[0], '/') != NULL) ? strrchr(argv[0], '/') + 1 : argv[0], runChunk, &base);
+		if(out.fp != stdout) fclose(out.fp);
+		return 0;
+	}
+	
+	PROFILE_START();
+	if(singleRep >= 0){ // regenerate one replicate from its coordinates
+		clearResult(&total);
+		runChunk(singleScenario, engine, singleRep, 1, &base, &total);
+		printf("%d %d %d %d %d\n", total.numInfects, total.dayInfectionCease, total.gameCount, total.infectedInGame, total.massInfection);
+		PROFILE_REPORT(traceName);
+		return 0;
+	}
+	
+	// the points to run, only the defaults without -s
+	nPoints = 1;
+	if(specName != NULL){
+		if(readSweep(specName, &sweep) < 0) return 1;
+		nPoints = sweep.nPoints;
+	}
+	par = malloc(nPoints * sizeof(PARAMS));
+	for(point=0; point<nPoints; point++){
+		if(specName == NULL) par[point] = base;
+		else if(sweepPoint(&sweep, point, &base, &par[point]) < 0) return 1;
+		if(network != NULL && par[point].member != network->n){
+			fprintf(stderr, "%s: MEMBER is the %d nodes of the network\n", argv[0], network->n);
+			return 1;
+		}
+	}
+	
+	if(tolerance > 0.0){ // the master equation instead of replicates
+		out.fp = (specName != NULL && outName != NULL) ? fopen(outName, "w") : stdout;
+		if(out.fp == NULL){
+			fprintf(stderr, "%s: cannot open\n", outName);
+			return 1;
+		}
+		status = solveMaster(par, nPoints, tolerance, (specName != NULL) ? &sweep : NULL, out.fp);
+		if(out.fp != stdout) fclose(out.fp);
+		free(par);
+		return (status < 0) ? 1 : 0;
+	}
+	
+	streams = malloc(streamsFor(par, nPoints) * sizeof(MT64));
+	if(rngMode == RNG_MT) setRandomSeed(streams);
+	
+	// the policies of -t and the network are part of the run a checkpoint or shard belongs to
+	checkpointSalt = (schedules != NULL) ? hashBytes(schedules, nScenarios * sizeof(SCHEDULE), 0) : 0;
+	if(network != NULL){
+		checkpointSalt = hashBytes(network->offset, (network->n + 1) * sizeof(int), checkpointSalt);
+		checkpointSalt = hashBytes(network->adj, network->offset[network->n] * sizeof(int), checkpointSalt);
+		checkpointSalt = hashBytes(network->weight, network->offset[network->n] * sizeof(int), checkpointSalt);
+	}
+	if(checkpointFile != NULL) startCheckpoints(checkpointFile);
+	
+	if(specName == NULL) status = (leagueTeams > 0) ? runLeagues(par, nPoints, engine, printResults, NULL, teamName) : runPoints(par, nPoints, engine, runChunk, streams, printResults, NULL);
+	else {
+		out.fp = (outName != NULL) ? fopen(outName, "w") : stdout;
+		if(out.fp == NULL){
+			fprintf(stderr, "%s: cannot open\n", outName);
+			return 1;
+		}
+		out.sw = &sweep;
+		if(shardCount == 1) writeSweepHeader(&out); // the merge writes the rows
+		status = (leagueTeams > 0) ? runLeagues(par, nPoints, engine, writeSweepRows, &out, teamName) : runPoints(par, nPoints, engine, runChunk, streams, writeSweepRows, &out);
+		if(out.fp != stdout) fclose(out.fp);
+	}
+	
+	PROFILE_REPORT(traceName);
+	free(streams);
+	free(par);
+	return (status < 0) ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,256 @@
+/*
+   Testing schedules read from a file (-t file), so that new policies run
+   without editing the programs, many of them in one run.
+
+   Every policy of the file becomes a scenario of the run, in the order of
+   the file, in place of the scenarios of the program. A policy starts
+   with a policy line and sets its parameters with the lines that follow,
+
+     # antigen on Mon, Wed and Fri, positives confirmed by PCR read 2 days later
+     policy = mwf_confirmed
+     test = antigen+pcr       # none, antigen, pcr or antigen+pcr
+     sensitivity = 0.5        # of the antigen test, relative to PCR, or a profile by state,
+                              # P1, P2, Is, Ia, e.g. 0.3, 0.6, 0.9, 0.7
+     days = Mon, Wed, Fri     # or daily
+     period = 1               # weeks, the tests run in one week of the period
+     phase = 0                # that week, 0,..., period-1, or random: the week of the parity drawn
+                              # for the replicate, with period 2 only
+     read = 2                 # days until a PCR result is read, 0: at once
+     escalate = pcr           # the test every day after the first isolation, none: no escalation
+     every = 2                # days between the escalated tests
+     escalate_read = 1        # read time of the escalated PCR
+
+   The defaults are test none, sensitivity 1, no days, period 1, phase 0,
+   read 1, escalate none, every 1 and escalate_read 1. The sensitivities
+   are from 0 to 1. One value is the antigen of the scenario in PARAMS, so
+   the sweep keys antigen and antigen0, antigen1,... change it; a profile
+   sets antigenProfile of the scenario and antigen 1, and those keys scale
+   the profile.
+
+   A policy is compiled into a table of the test by (week in the period,
+   day of the week) for the regular tests, and the test of an escalated
+   day is the escalation test every `every` days, so the daily routine
+   looks its test up in O(1). The policies share their random numbers
+   (commonNumbers), the differences between them are not blurred by noise.
+*/
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include "policies.h"
+
+#define MAX_PERIOD 16 // weeks of a period
+
+typedef struct schedule {
+	char name[64];
+	double sensitivity; // of the antigen test relative to PCR
+	double profile[STATES]; // times sensitivity by state, 1: the profile of PCR
+	int period; // weeks
+	int phase; // week of the tests in the period, -1: the parity r->lastPCR of the replicate
+	int read; // days until a PCR result of the regular tests is read, 0: at once
+	unsigned char test[MAX_PERIOD][7]; // TEST_* of (week in the period, whatDay), the compiled table
+	int escalation; // TEST_* after the first isolation, TEST_NONE: no escalation
+	int every; // days between the escalated tests
+	int escalationRead;
+	int disclose; // 1: PCR results can be pending
+} SCHEDULE;
+
+static SCHEDULE *schedules = NULL; // the policies of -t, NULL: the scenarios of the program
+
+// the profile of a sensitivity line, one value or the values of P1, P2, Is and Ia, -1 if it is neither
+static int profileByName(char *list, SCHEDULE *sc)
+{
+	static const int state[4] = {2, 3, 4, 5}; // P1, P2, Is, Ia
+	char *item, *end;
+	double x[4];
+	int n = 0, i;
+
+	for(item = strtok(list, ","); item != NULL; item = strtok(NULL, ",")){
+		if(n == 4) return -1;
+		x[n] = strtod(item, &end);
+		while(*end == ' ' || *end == '\t') end++;
+		if(end == item || *end != '\0' || !(x[n] >= 0.0 && x[n] <= 1.0)) return -1;
+		n++;
+	}
+	if(n != 1 && n != 4) return -1;
+	for(i=0; i<STATES; i++) sc->profile[i] = 1.0;
+	sc->sensitivity = x[0];
+	if(n == 4){
+		sc->sensitivity = 1.0;
+		for(i=0; i<4; i++) sc->profile[state[i]] = x[i];
+	}
+	return 0;
+}
+
+// TEST_* from its name, -1 if unknown
+static int testByName(const char *name)
+{
+	if(strcmp(name, "none") == 0) return TEST_NONE;
+	if(strcmp(name, "antigen") == 0) return TEST_ANTIGEN;
+	if(strcmp(name, "pcr") == 0) return TEST_PCR;
+	if(strcmp(name, "antigen+pcr") == 0) return TEST_ANTIGEN_PCR;
+	return -1;
+}
+
+// bit whatDay (0: Saturday,..., 6: Friday) of a list of day names, -1 on an unknown name
+static int daysByName(char *list)
+{
+	static const char *dayName[7] = {"Sat", "Sun", "Mon", "Tue", "Wed", "Thu", "Fri"};
+	char *item, *end;
+	int days = 0, day;
+
+	if(strcmp(list, "daily") == 0) return 0x7F;
+	for(item = strtok(list, ","); item != NULL; item = strtok(NULL, ",")){
+		while(*item == ' ' || *item == '\t') item++;
+		for(end = item + strlen(item); end > item && (end[-1] == ' ' || end[-1] == '\t'); end--);
+		*end = '\0';
+		for(day=0; day<7 && strcmp(item, dayName[day]) != 0; day++);
+		if(day == 7) return -1;
+		days |= 1 << day;
+	}
+	return days;
+}
+
+// *x from a whole number, -1 if value is anything else
+static int intByName(const char *value, int *x)
+{
+	char *end;
+	long v = strtol(value, &end, 10);
+
+	if(end == value || *end != '\0' || v < INT_MIN || v > INT_MAX) return -1;
+	*x = (int)v;
+	return 0;
+}
+
+// the table of the regular tests, the days of the week are the bits of days; -1 if the phase is out of the period
+static int compileSchedule(SCHEDULE *sc, int test, int days)
+{
+	int week, day, testWeek = (sc->phase < 0) ? 0 : sc->phase;
+
+	if(sc->phase >= sc->period || (sc->phase < 0 && sc->period != 2)) return -1;
+	for(week=0; week<MAX_PERIOD; week++)
+		for(day=0; day<7; day++)
+			sc->test[week][day] = (week == testWeek && ((days >> day) & 1)) ? test : TEST_NONE;
+	sc->disclose = (test == TEST_PCR || test == TEST_ANTIGEN_PCR || sc->escalation == TEST_PCR || sc->escalation == TEST_ANTIGEN_PCR);
+	return 0;
+}
+
+// read the policies of a file into schedules[], returns their number, or -1 and prints the reason on an error
+int readSchedules(const char *fileName)
+{
+	FILE *fp;
+	char line[1024], *eq, *key, *value, *end;
+	int lineNumber = 0, n = 0, i, test = TEST_NONE, days = 0;
+	SCHEDULE *sc = NULL;
+
+	fp = fopen(fileName, "r");
+	if(fp == NULL){
+		fprintf(stderr, "%s: cannot open\n", fileName);
+		return -1;
+	}
+	schedules = calloc(MAX_SCENARIOS, sizeof(SCHEDULE)); // no stray bytes for the fingerprint of checkpoint.h
+	while(fgets(line, sizeof(line), fp) != NULL){
+		lineNumber++;
+		if((end = strchr(line, '#')) != NULL) *end = '\0';
+		for(key = line; *key == ' ' || *key == '\t'; key++);
+		if(*key == '\0' || *key == '\n' || *key == '\r') continue; // blank line
+
+		eq = strchr(key, '=');
+		if(eq == NULL) goto bad;
+		for(end = eq; end > key && (end[-1] == ' ' || end[-1] == '\t'); end--);
+		*end = '\0';
+		for(value = eq + 1; *value == ' ' || *value == '\t'; value++);
+		for(end = value + strlen(value); end > value && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'); end--);
+		*end = '\0';
+
+		if(strcmp(key, "policy") == 0){
+			if(sc != NULL && compileSchedule(sc, test, days) < 0) goto bad;
+			if(n == MAX_SCENARIOS || strlen(value) >= sizeof(sc->name)) goto bad;
+			sc = &schedules[n++];
+			strcpy(sc->name, value);
+			sc->sensitivity = 1.0;
+			for(i=0; i<STATES; i++) sc->profile[i] = 1.0;
+			sc->period = 1;
+			sc->phase = 0;
+			sc->read = 1;
+			sc->escalation = TEST_NONE;
+			sc->every = 1;
+			sc->escalationRead = 1;
+			test = TEST_NONE;
+			days = 0;
+			continue;
+		}
+		if(sc == NULL) goto bad; // a parameter before the first policy
+
+		if(strcmp(key, "test") == 0){
+			if((test = testByName(value)) < 0) goto bad;
+		} else if(strcmp(key, "sensitivity") == 0){
+			if(profileByName(value, sc) < 0) goto bad;
+		} else if(strcmp(key, "days") == 0){
+			if((days = daysByName(value)) < 0) goto bad;
+		} else if(strcmp(key, "period") == 0){
+			if(intByName(value, &sc->period) < 0 || sc->period < 1 || sc->period > MAX_PERIOD) goto bad;
+		} else if(strcmp(key, "phase") == 0){
+			if(strcmp(value, "random") == 0) sc->phase = -1;
+			else if(intByName(value, &sc->phase) < 0 || sc->phase < 0) goto bad;
+		} else if(strcmp(key, "read") == 0){
+			if(intByName(value, &sc->read) < 0 || sc->read < 0 || sc->read > DUE_DAYS) goto bad;
+		} else if(strcmp(key, "escalate") == 0){
+			if((sc->escalation = testByName(value)) < 0) goto bad;
+		} else if(strcmp(key, "every") == 0){
+			if(intByName(value, &sc->every) < 0 || sc->every < 1) goto bad;
+		} else if(strcmp(key, "escalate_read") == 0){
+			if(intByName(value, &sc->escalationRead) < 0 || sc->escalationRead < 0 || sc->escalationRead > DUE_DAYS) goto bad;
+		} else goto bad;
+	}
+	lineNumber++; // the end of the last policy
+	if(sc != NULL && compileSchedule(sc, test, days) < 0) goto bad;
+	fclose(fp);
+	if(n == 0){
+		fprintf(stderr, "%s: no policy\n", fileName);
+		return -1;
+	}
+	return n;
+
+  bad:
+	fprintf(stderr, "%s:%d: bad policy line, see schedule.h\n", fileName, lineNumber);
+	fclose(fp);
+	return -1;
+}
+
+// the tests of day d in a scenario of schedules[]
+void scheduleTests(int scenario, REPLICATE *r, int d, int whatDay, int stateNumber[], INDIV *indiv, const PARAMS *par)
+{
+	const SCHEDULE *sc = &schedules[scenario];
+	int test, read;
+
+	// see the results of PCR testing
+	if(sc->disclose) disclosurePCRresult(par->member, stateNumber, indiv, d);
+
+	if(r->testMode == 0){
+		test = sc->test[(sc->phase < 0) ? (d/7 + 2 - r->lastPCR) % 2 : (d/7) % sc->period][whatDay];
+		read = sc->read;
+	} else { // escalated after the first isolation
+		test = (r->addTestDays % sc->every == 0) ? sc->escalation : TEST_NONE;
+		read = sc->escalationRead;
+		r->addTestDays++;
+	}
+
+	switch(test){
+	  case TEST_ANTIGEN:
+		doAntigenTest(par->member, stateNumber, indiv, par->antigenSTV[scenario]);
+		break;
+	  case TEST_PCR:
+		if(read == 0) doPCRtestWithZeroReadTime(par->member, stateNumber, indiv, par->PCRSTV);
+		else doTest(par->member, indiv, par->PCRSTV, d + read);
+		break;
+	  case TEST_ANTIGEN_PCR:
+		doConfirmedTest(par->member, stateNumber, indiv, par->antigenSTV[scenario], par->PCRSTV, d, read);
+		break;
+	}
+
+	// if quarantined person arise, change test mode
+	if(sc->escalation != TEST_NONE && stateNumber[7] > 0) r->testMode = 1;
+}
+
+#endif
@@ -0,0 +1,162 @@
+/*
+   Lane-batched engine for the infection process within a day (-e simd).
+
+   LANES independent replicates advance together, one per SIMD lane. For
+   the day the states are held as structure of arrays, st[member] is a
+   vector with the state of that member in every lane, and the switch of
+   infections_in_a_day() becomes compares and blends on whole vectors.
+   Uniforms come from one xoshiro128** generator per lane and are compared
+   as 32-bit integers with fixed-point thresholds p * 2^32. Lanes whose
+   replicate is over are masked out.
+
+   The vectors use the GCC vector extension: LANES 8 fills AVX2 registers,
+   LANES 16 fills AVX-512 (-mavx512f -DLANES=16), and LANES 1 or a target
+   without SIMD gives plain scalar code.
+*/
+
+#ifndef SIMDENGINE_H
+#define SIMDENGINE_H
+
+#include "model.h"
+
+#ifndef LANES
+#define LANES 8 // replicates advanced together
+#endif
+
+typedef unsigned int v32 __attribute__((vector_size(4*LANES)));
+
+typedef struct simdRng {
+	v32 s[4]; // xoshiro128** state, one generator per lane
+} SIMDRNG;
+
+#define ROTL32(x, k) (((x) << (k)) | ((x) >> (32 - (k))))
+
+// next 32-bit random integer in every lane, vectors are passed by pointer
+// so that builds without AVX do not warn about the vector ABI
+static inline void simdNext(SIMDRNG *g, v32 *result)
+{
+	v32 t = g->s[1] << 9;
+
+	PROFILE_DRAWS(LANES);
+	*result = ROTL32(g->s[1] * 5, 7) * 9;
+
+	g->s[2] ^= g->s[0];
+	g->s[3] ^= g->s[1];
+	g->s[1] ^= g->s[2];
+	g->s[0] ^= g->s[3];
+	g->s[2] ^= t;
+	g->s[3] = ROTL32(g->s[3], 11);
+}
+
+// seed the lane generators from the stream of this thread
+void seedSimdRng(SIMDRNG *g)
+{
+	int lane, i;
+	unsigned long long x;
+
+	for(lane=0; lane<LANES; lane++){
+		for(i=0; i<4; i+=2){
+			x = mt64_int64(currentStream);
+			g->s[i][lane] = (unsigned int)x;
+			g->s[i+1][lane] = (unsigned int)(x >> 32) | 1u; // never all zero
+		}
+	}
+}
+
+// seed the generator of one lane from the draws of its replicate, for RNG_PHILOX
+void seedSimdLane(SIMDRNG *g, int lane)
+{
+	int i;
+
+	rngAt(STEP_SIMD, 0);
+	for(i=0; i<4; i++) g->s[i][lane] = (unsigned int)(urand() * 4294967296.0) | (i == 0); // never all zero
+}
+
+// fixed-point threshold, u < threshold(p) has probability p for a uniform 32-bit u
+static inline unsigned int threshold(double p)
+{
+	if(p >= 1.0) return 0xFFFFFFFFu;
+	if(p <= 0.0) return 0u;
+	return (unsigned int)(p * 4294967296.0);
+}
+
+// the lanes with active[lane] != 0 run one day, lanes beyond the batch must be inactive
+void infections_in_a_day_simd(int stateNumber[][STATES], INDIV indiv[], const int active[], SIMDRNG *g, const PARAMS *par)
+{
+	int t, member, lane, s, n = par->member;
+	unsigned int thrBeta, maxInfectious;
+	v32 st[MAX_MEMBER], inPopulation[MAX_MEMBER], num[STATES], on, zero = {0};
+	v32 u, u2, thr, thrForce, infectious, move, counted, next, toIs, isIs;
+	v32 is0, is1, is2, is3, is4, is5, moved0, moved1, moved2, moved3, moved4, moved5;
+	v32 thrSigma, thrRho, thrGamma, thrEta;
+
+	// structure of arrays for the lanes
+	for(lane=0; lane<LANES; lane++){
+		on[lane] = active[lane] ? 0xFFFFFFFFu : 0u;
+		for(s=0; s<STATES; s++) num[s][lane] = active[lane] ? (unsigned int)stateNumber[lane][s] : 0u;
+		for(member=0; member<n; member++){
+			st[member][lane] = active[lane] ? (unsigned int)indiv[lane].state[member] : 6u;
+			inPopulation[member][lane] = (active[lane] && !testBit(indiv[lane].quarantine, member)) ? 0xFFFFFFFFu : 0u;
+		}
+	}
+
+	thrSigma = zero + threshold(par->sigma);
+	thrRho = zero + threshold(par->rho);
+	thrGamma = zero + threshold(par->gamma);
+	thrEta = zero + threshold(par->eta);
+	thrBeta = threshold(par->beta);
+	maxInfectious = thrBeta ? 0xFFFFFFFFu / thrBeta : 0xFFFFFFFFu; // beyond this the force saturates
+
+	for(t=0; t<par->oneT; t++){
+		infectious = num[2] + num[3] + num[4] + num[5];
+		thrForce = (infectious * thrBeta) | (v32)(infectious > maxInfectious);
+		moved0 = moved1 = moved2 = moved3 = moved4 = moved5 = toIs = zero;
+
+		for(member=0; member<n; member++){
+			simdNext(g, &u);
+			simdNext(g, &u2);
+			is0 = (v32)(st[member] == 0);
+			is1 = (v32)(st[member] == 1);
+			is2 = (v32)(st[member] == 2);
+			is3 = (v32)(st[member] == 3);
+			is4 = (v32)(st[member] == 4);
+			is5 = (v32)(st[member] == 5);
+
+			thr = (is0 & thrForce) | (is1 & thrSigma) | ((is2 | is3) & thrRho) | ((is4 | is5) & thrGamma);
+			move = (v32)(u < thr) & on;
+
+			// S, E, P1 -> next state, P2 -> Is (4) or Ia (5), Is and Ia -> R (6)
+			isIs = (v32)(u2 < thrEta);
+			next = st[member] + 1;
+			next += is3 & ~isIs & 1; // 3 + 1 + 1 = 5
+			next += (is4 | is5) & (6 - next);
+			st[member] = (move & next) | (~move & st[member]);
+
+			// change the stateNumber only when the individual is not quarantined, the masks are -1
+			counted = move & inPopulation[member];
+			moved0 -= is0 & counted;
+			moved1 -= is1 & counted;
+			moved2 -= is2 & counted;
+			moved3 -= is3 & counted;
+			moved4 -= is4 & counted;
+			moved5 -= is5 & counted;
+			toIs -= is3 & counted & isIs;
+		}
+
+		num[0] -= moved0;
+		num[1] += moved0 - moved1;
+		num[2] += moved1 - moved2;
+		num[3] += moved2 - moved3;
+		num[4] += toIs - moved4;
+		num[5] += moved3 - toIs - moved5;
+		num[6] += moved4 + moved5;
+	} // one_t
+
+	for(lane=0; lane<LANES; lane++){
+		if(!active[lane]) continue;
+		for(s=0; s<STATES; s++) stateNumber[lane][s] = (int)num[s][lane];
+		for(member=0; member<n; member++) moveMember(&indiv[lane], member, (int)st[member][lane]);
+	}
+}
+
+#endif
@@ -0,0 +1,404 @@
+/*
+   The simulation core shared by regularTesting.c and addTesting.c: the
+   infection process within a day, the tests, the symptom check and the
+   replicate state. The programs differ only in their testing policies
+   (policies.h) and plug them into program.h.
+*/
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "model.h"
+#include "binomialEngine.h"
+#include "gillespieEngine.h"
+#include "tauEngine.h"
+#include "timerWheelEngine.h"
+#include "simdEngine.h"
+#include "fastForward.h"
+#include "network.h"
+
+#define R_0 5.0 // basic reproductive ratio
+
+#define REG_READ_TIME 3
+
+
+// net: the contacts of the population (network.h), NULL: mass action
+KERNEL void infections_in_a_day_kernel(int n, int stateNumber[], INDIV *indiv, const PARAMS *par, int firstStep, const NETWORK *net)
+{
+	int t, member, indivState;
+	double rnd, rnd2, force_infection, block[MAX_MEMBER][2];
+	double beta = par->beta, gamma = par->gamma, rho = par->rho, sigma = par->sigma, eta = par->eta;
+	double netBeta = (net != NULL) ? beta * par->member / net->meanDegree : 0.0; // per weight unit of an infectious neighbour
+	
+	
+	for(t=firstStep; t<par->oneT; t++){
+		force_infection = beta*(double)(stateNumber[2] + stateNumber[3] + stateNumber[4] + stateNumber[5]);
+		if(net != NULL) updateNetSums(net, indiv, n); // the changes since the last step
+		if(rngMode == RNG_PHILOX) urandBlock(t, n, block); // draws keyed by (step, member)
+		for(member=0; member<n; member++){
+			indivState = indiv->state[member];
+			rnd = (rngMode == RNG_PHILOX) ? block[member][0] : urand(); // random real (0, 1)
+			switch (indivState) {
+			  case 0: //susceptible
+				if (rnd < ((net != NULL) ? netBeta * (double)netSums.sum[member] : force_infection)) { 
+					moveMember(indiv, member, 1); 
+					stateNumber[0]--;
+					stateNumber[1]++;
+				}
+				break;
+			  case 1: // exposed 
+				if (rnd < sigma) {//if rnd is smaller than sigma, this individual becomes P1 (state is 2)
+					moveMember(indiv, member, 2); 
+					stateNumber[1]--;
+					stateNumber[2]++;
+				}
+				
+				 break;
+			  case 2: // P1
+				if (rnd < rho) { //if rnd is smaller than rho, this individual becomes P2
+					moveMember(indiv, member, 3); 
+					// note that this individuals may already have been quarantined (state 7)
+					// change the stateNumber only when this individuals is not quarantined
+					if(!testBit(indiv->quarantine, member)){ 
+						stateNumber[2]--;
+						stateNumber[3]++;
+					}
+				}
+				break;
+			  case 3: // P2
+				if (rnd < rho) { //P2 individuals will be either Is or Ia
+					rnd2 = (rngMode == RNG_PHILOX) ? block[member][1] : urand(); //もう一つ乱数を引いて
+					if (rnd2 < eta) { 
+						moveMember(indiv, member, 4);
+						// change the stateNumber only when this individuals is not quarantined
+						if(!testBit(indiv->quarantine, member)){
+							stateNumber[3]--;
+							stateNumber[4]++;
+						}
+					} else { 
+						moveMember(indiv, member, 5);
+						// change the stateNumber only when this individuals is not quarantined
+						if(!testBit(indiv->quarantine, member)){
+							stateNumber[3]--;
+							stateNumber[5]++;
+						}
+					}
+				}
+				break;
+			  case 4: // Is
+				if (rnd < gamma) {// recovery?
+					moveMember(indiv, member, 6); 
+					// change the stateNumber only when this individuals is not quarantined
+					if(!testBit(indiv->quarantine, member)){
+						stateNumber[4]--;
+						stateNumber[6]++;
+					}
+				}
+				break;
+			  case 5: // Ia
+				if (rnd < gamma) {
+					moveMember(indiv, member, 6); 
+					// change the stateNumber only when this individuals is not quarantined
+					if(!testBit(indiv->quarantine, member)){
+						stateNumber[5]--;
+						stateNumber[6]++;
+					}
+				}
+				break;
+			  case 6: // recovered
+				//do nothing
+				break;
+			} //end switch
+		}
+		//printf("\n");
+
+	} //one_t
+}
+
+// the ONE_T steps firstStep,..., par->oneT-1 of a day
+void infections_in_a_day(int stateNumber[], INDIV *indiv, const PARAMS *par, int firstStep)
+{
+	if(network != NULL) infections_in_a_day_kernel(par->member, stateNumber, indiv, par, firstStep, network);
+	else SPECIALIZE_MEMBER(par->member, infections_in_a_day_kernel, stateNumber, indiv, par, firstStep, NULL);
+}
+
+void setPCRSensitivity(double PCRSTV[])
+{
+	PCRSTV[0] = 0;
+	PCRSTV[1] = 0;// E
+	PCRSTV[2] = 0.33; //P1
+	PCRSTV[3] = 0.62; //P2
+	PCRSTV[4] = 0.8; //Iss
+	PCRSTV[5] = 0.8; //Isa
+	PCRSTV[6] = 0; // R
+	PCRSTV[7] = 0; // quarantined
+}
+
+KERNEL void doTestKernel(int n, INDIV *indiv, const double sensitivity[], int dueDay)
+{
+	int w, member, state, day;
+	unsigned long long tested, bits;
+	double rnd;
+	for(w=0; 64*w<n; w++){
+		tested = memberWord(n, w) & ~indiv->quarantine[w]; // if the person has not isolated yet, check
+		// only infected members can be positive
+		for(bits = indiv->infected[w] & tested; bits; bits &= bits-1){
+			member = 64*w + LOWEST(bits);
+			state = indiv->state[member];
+			if(sensitivity[state] > 0.0){
+				rngAt(STEP_TEST, member);
+				rnd = urand();
+				if(rnd < sensitivity[state]){ 
+					setBit(indiv->testResult, member); // test positive
+				}
+			}
+		}
+		// they are waiting for the result of this test only, read on dueDay
+		for(day=0; day<DUE_DAYS; day++) indiv->due[day][w] &= ~tested;
+		indiv->due[dueDay % DUE_DAYS][w] |= tested;
+	} // member
+}
+
+void doTest(int n, INDIV *indiv, const double sensitivity[], int dueDay)
+{
+	PROFILE_PHASE(PHASE_TEST);
+	SPECIALIZE_MEMBER(n, doTestKernel, indiv, sensitivity, dueDay);
+	PROFILE_PHASE(PHASE_DAY);
+}
+
+KERNEL void doAntigenTestKernel(int n, int stateNumber[], INDIV *indiv, const double sensitivity[])
+{
+	int w, member, state;
+	unsigned long long bits;
+	double rnd;
+	for(w=0; 64*w<n; w++){
+		// only infected members can be positive, if the person has not isolated yet, check
+		for(bits = indiv->infected[w] & ~indiv->quarantine[w]; bits; bits &= bits-1){
+			member = 64*w + LOWEST(bits);
+			state = indiv->state[member];
+			
+			if(sensitivity[state]>0.0){
+				rngAt(STEP_TEST, member);
+				rnd = urand();
+				if(rnd < sensitivity[state]){
+					// reading time is 0, isolate the person immediately
+					setBit(indiv->quarantine, member); // isolate
+					stateNumber[state]--;
+					stateNumber[7]++;
+				}
+			}
+		}
+	} // member
+}
+
+void doAntigenTest(int n, int stateNumber[], INDIV *indiv, const double sensitivity[])
+{
+	PROFILE_PHASE(PHASE_TEST);
+	SPECIALIZE_MEMBER(n, doAntigenTestKernel, stateNumber, indiv, sensitivity);
+	PROFILE_PHASE(PHASE_DAY);
+}
+
+KERNEL void doPCRtestWithZeroReadTimeKernel(int n, int stateNumber[], INDIV *indiv, const double sensitivity[])
+{
+	int w, member, state;
+	unsigned long long bits;
+	double rnd;
+	for(w=0; 64*w<n; w++){
+		// only infected members can be positive, if the person has not isolated yet, check
+		for(bits = indiv->infected[w] & ~indiv->quarantine[w]; bits; bits &= bits-1){
+			member = 64*w + LOWEST(bits);
+			state = indiv->state[member];
+			
+			if(sensitivity[state]>0.0){
+				rngAt(STEP_TEST, member);
+				rnd = urand();
+				if(rnd < sensitivity[state]){
+					// reading time is 0, isolate the person immediately
+					setBit(indiv->testResult, member); // test positive
+					setBit(indiv->quarantine, member); // isolate
+					stateNumber[state]--;
+					stateNumber[7]++;
+				}
+			}
+		}
+	} // member
+}
+
+void doPCRtestWithZeroReadTime(int n, int stateNumber[], INDIV *indiv, const double sensitivity[])
+{
+	PROFILE_PHASE(PHASE_TEST);
+	SPECIALIZE_MEMBER(n, doPCRtestWithZeroReadTimeKernel, stateNumber, indiv, sensitivity);
+	PROFILE_PHASE(PHASE_DAY);
+}
+
+KERNEL void doConfirmedTestKernel(int n, int stateNumber[], INDIV *indiv, const double antigenSTV[], const double PCRSTV[], int d, int readTime)
+{
+	int w, member, state, day;
+	unsigned long long bits;
+	for(w=0; 64*w<n; w++){
+		// only infected members can be positive, if the person has not isolated yet, check
+		for(bits = indiv->infected[w] & ~indiv->quarantine[w]; bits; bits &= bits-1){
+			member = 64*w + LOWEST(bits);
+			state = indiv->state[member];
+			
+			if(antigenSTV[state]>0.0){
+				rngAt(STEP_TEST, member);
+				// an antigen positive takes a PCR test, the second draw
+				if(urand() < antigenSTV[state] && urand() < PCRSTV[state]){
+					setBit(indiv->testResult, member); // test positive
+					if(readTime == 0){ // isolate the person immediately
+						setBit(indiv->quarantine, member);
+						stateNumber[state]--;
+						stateNumber[7]++;
+					} else { // wait for the PCR result, read on day d + readTime
+						for(day=0; day<DUE_DAYS; day++) indiv->due[day][w] &= ~(1ULL << (member & 63));
+						setBit(indiv->due[(d + readTime) % DUE_DAYS], member);
+					}
+				}
+			}
+		}
+	} // member
+}
+
+// antigen tests whose positives are confirmed by PCR, read readTime days after day d
+void doConfirmedTest(int n, int stateNumber[], INDIV *indiv, const double antigenSTV[], const double PCRSTV[], int d, int readTime)
+{
+	PROFILE_PHASE(PHASE_TEST);
+	SPECIALIZE_MEMBER(n, doConfirmedTestKernel, stateNumber, indiv, antigenSTV, PCRSTV, d, readTime);
+	PROFILE_PHASE(PHASE_DAY);
+}
+
+KERNEL void initializePopulationKernel(int n, int stateNumber[], INDIV *indiv)
+{
+	int i;
+
+	// all susceptible, not quarantined, negative and not waiting
+	memset(indiv, 0, sizeof(INDIV));
+	stateNumber[0] = n;
+	for(i=1; i<STATES; i++) stateNumber[i]=0;
+}
+
+void initializePopulation(int n, int stateNumber[], INDIV *indiv)
+{
+	SPECIALIZE_MEMBER(n, initializePopulationKernel, stateNumber, indiv);
+}
+
+KERNEL void dailySymptomCheckKernel(int n, int stateNumber[], INDIV *indiv)
+{
+	int w;
+	unsigned long long isolated;
+	
+	for(w=0; 64*w<n; w++){
+		// the persons who have a symptom and have not isolated yet, a pending PCR result of an isolated person is ignored
+		isolated = indiv->symptomatic[w] & ~indiv->quarantine[w];
+		indiv->quarantine[w] |= isolated; // isolate these persons
+		stateNumber[4] -= POPCOUNT(isolated);
+		stateNumber[7] += POPCOUNT(isolated); // increase a number of isolated people
+	} // member
+}
+
+void dailySymptomCheck(int n, int stateNumber[], INDIV *indiv)
+{
+	PROFILE_PHASE(PHASE_SYMPTOM);
+	SPECIALIZE_MEMBER(n, dailySymptomCheckKernel, stateNumber, indiv);
+	PROFILE_PHASE(PHASE_DAY);
+}
+
+
+KERNEL void disclosurePCRresultKernel(int n, int stateNumber[], INDIV *indiv, int d)
+{
+	int w;
+	unsigned long long *due = indiv->due[d % DUE_DAYS], positive, bits;
+	
+	// the individuals whose test results are read today
+	for(w=0; 64*w<n; w++){
+		// isolate the individuals who are PCR positive and have not isolated yet
+		positive = due[w] & ~indiv->quarantine[w] & indiv->testResult[w];
+		indiv->quarantine[w] |= positive;
+		for(bits=positive; bits; bits &= bits-1) stateNumber[indiv->state[64*w + LOWEST(bits)]]--; // the person's state
+		stateNumber[7] += POPCOUNT(positive); // isolation 
+		// clear waiting information, for all members
+		due[w] = 0; // relese the persons from waiting 
+	}
+}
+
+void disclosurePCRresult(int n, int stateNumber[], INDIV *indiv, int d)
+{
+	PROFILE_PHASE(PHASE_DISCLOSURE);
+	SPECIALIZE_MEMBER(n, disclosurePCRresultKernel, stateNumber, indiv, d);
+	PROFILE_PHASE(PHASE_DAY);
+}
+
+
+typedef struct replicate {
+	int dayBegin; // a day of week when new E arize, 0: Saturday, 1: Sunday,..., 6: Friday
+	int lastPCR; // When was the last PCR, 0: two weeks ago, 1: last week
+	int testMode; // 0: regular tests, 1: additional tests after the first isolation (reactiveTests())
+	int addTestDays; // days in the additional test mode
+	int bp; // tag for break
+	int quarantineOfTheWeek;
+	int massInfection;
+	int dayInfectionCease;
+	int gameCount; // games played
+	int infectedInGame; // infected individuals (P1, P2, Is, Ia) who played a game
+	QUIET quiet; // quiescent period for -f
+} REPLICATE;
+
+void beginReplicate(REPLICATE *r, int stateNumber[], INDIV *indiv, const PARAMS *par)
+{
+	// counters for measure items
+	r->bp = 0; // reset tag for break
+	r->quarantineOfTheWeek = 0;
+	r->massInfection = 0;
+	r->dayInfectionCease = 7*par->weeks; // infection did not cease within the simulation length
+	r->gameCount = 0;
+	r->infectedInGame = 0;
+	r->quiet.until = -1;
+	
+	// initialization
+	initializePopulation(par->member, stateNumber, indiv);
+	// a day of week when new E arize
+	r->dayBegin = (int)(7.0 *urand()); //0: Saturday, 1: Sunday,..., 6: Friday
+	// When was the last PCR, 0: two weeks ago, 1: last week
+	r->lastPCR = (int)(2.0 * urand());
+	// end initialization
+	
+	// make one E individual
+	moveMember(indiv, 0, 1);
+	stateNumber[0]--;
+	stateNumber[1]++;
+	
+	r->testMode = 0;
+	r->addTestDays = 0;
+}
+
+// the check for mass infection at the end of a week, more than 4 isolations in the week
+void weeklyCheck(REPLICATE *r, const int stateNumber[])
+{
+	if(r->massInfection == 0) {
+		if(stateNumber[7]-r->quarantineOfTheWeek > 4){ //mass infection occurs
+			r->massInfection = 1;
+		}
+		r->quarantineOfTheWeek = stateNumber[7];
+	}
+}
+
+void endReplicate(REPLICATE *r, int stateNumber[], const PARAMS *par, RESULT *total)
+{
+	double x[VALUES];
+	
+	total->numInfects += par->member-stateNumber[0];
+	total->dayInfectionCease += r->dayInfectionCease;
+	total->massInfection += r->massInfection;
+	total->gameCount += r->gameCount;
+	total->infectedInGame += r->infectedInGame;
+	
+	x[0] = par->member-stateNumber[0];
+	x[1] = r->dayInfectionCease;
+	x[2] = r->infectedInGame;
+	x[3] = r->massInfection;
+	x[VALUE_GAMES] = r->gameCount;
+	addValues(&total->stat, x);
+}
+
+#endif
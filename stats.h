@@ -0,0 +1,184 @@
+/*
+   Streaming statistics of the measure items and the stopping rule of -p.
+
+   Every replicate adds its values to Welford accumulators (running means
+   and sums of squared deviations), and the accumulators of the chunks are
+   merged in chunk order with the pairwise formula of Chan, Golub and
+   LeVeque, so the statistics do not depend on the number of threads.
+
+   The measure items are the means of the values, except infected in game,
+   which is the ratio of infected players to games over all replicates as
+   before, and its standard error comes from the delta method with the
+   co-moment of the two. The confidence intervals are mean +- CONFIDENCE_Z SE.
+
+   With a precision p > 0 the replicates of a scenario run in rounds, the
+   first of MIN_REPS, until the half-width of the confidence interval of
+   every item the program reports (reportItems) is at most p times its
+   mean or par->reps replicates are done.
+   After each round the replicates still needed are predicted from the
+   standard errors so far, SE shrinks as 1/sqrt(n).
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+#define VALUES 5 // per replicate: final size, cease day, infected in game, mass infection, games
+#define ITEMS 4 // measure items: final size, cease day, infected per game, mass infection probability
+#define VALUE_GAMES 4
+#define ITEM_IN_GAME 2 // infected in game / games
+#define CONFIDENCE_Z 1.96 // 95% confidence intervals
+#ifndef MIN_REPS
+#define MIN_REPS 1000 // replicates of the first round of -p
+#endif
+
+typedef struct stats {
+	long n; // replicates
+	double mean[VALUES];
+	double m2[VALUES]; // sum of squared deviations from the mean
+	double c2g; // co-moment of infected in game and games
+} STATS;
+
+void clearStats(STATS *s)
+{
+	memset(s, 0, sizeof(STATS));
+}
+
+// add the values of one replicate
+void addValues(STATS *s, const double x[VALUES])
+{
+	int v;
+	double d[VALUES];
+
+	s->n++;
+	for(v=0; v<VALUES; v++){
+		d[v] = x[v] - s->mean[v];
+		s->mean[v] += d[v] / s->n;
+		s->m2[v] += d[v] * (x[v] - s->mean[v]);
+	}
+	s->c2g += d[ITEM_IN_GAME] * (x[VALUE_GAMES] - s->mean[VALUE_GAMES]);
+}
+
+// a += b, the replicates of b follow those of a
+void mergeStats(STATS *a, const STATS *b)
+{
+	int v;
+	long n = a->n + b->n;
+	double d[VALUES], w;
+
+	if(b->n == 0) return;
+	if(a->n == 0){
+		*a = *b;
+		return;
+	}
+	w = (double)a->n * (double)b->n / (double)n;
+	for(v=0; v<VALUES; v++){
+		d[v] = b->mean[v] - a->mean[v];
+		a->mean[v] += d[v] * b->n / n;
+		a->m2[v] += b->m2[v] + d[v] * d[v] * w;
+	}
+	a->c2g += b->c2g + d[ITEM_IN_GAME] * d[VALUE_GAMES] * w;
+	a->n = n;
+}
+
+// samples of a scenario paired with scenario 0 on the same random numbers, for -v (see variance.h)
+typedef struct pairStats {
+	long n; // samples, one replicate or the mean of an antithetic pair
+	double mean[2][VALUES]; // [0]: the scenario, [1]: scenario 0
+	double m2[2][VALUES];
+	double cross[VALUES]; // co-moment of the scenario and scenario 0
+} PAIRSTATS;
+
+void clearPairs(PAIRSTATS *p)
+{
+	memset(p, 0, sizeof(PAIRSTATS));
+}
+
+// add a sample x of the scenario and its twin b of scenario 0
+void addPair(PAIRSTATS *p, const double x[VALUES], const double b[VALUES])
+{
+	int v;
+	double dx, db;
+
+	p->n++;
+	for(v=0; v<VALUES; v++){
+		dx = x[v] - p->mean[0][v];
+		db = b[v] - p->mean[1][v];
+		p->mean[0][v] += dx / p->n;
+		p->mean[1][v] += db / p->n;
+		p->m2[0][v] += dx * (x[v] - p->mean[0][v]);
+		p->m2[1][v] += db * (b[v] - p->mean[1][v]);
+		p->cross[v] += dx * (b[v] - p->mean[1][v]);
+	}
+}
+
+// a += b, the samples of b follow those of a
+void mergePairs(PAIRSTATS *a, const PAIRSTATS *b)
+{
+	int v, i;
+	long n = a->n + b->n;
+	double d[2], w;
+
+	if(b->n == 0) return;
+	if(a->n == 0){
+		*a = *b;
+		return;
+	}
+	w = (double)a->n * (double)b->n / (double)n;
+	for(v=0; v<VALUES; v++){
+		for(i=0; i<2; i++){
+			d[i] = b->mean[i][v] - a->mean[i][v];
+			a->mean[i][v] += d[i] * b->n / n;
+			a->m2[i][v] += b->m2[i][v] + d[i] * d[i] * w;
+		}
+		a->cross[v] += b->cross[v] + d[0] * d[1] * w;
+	}
+	a->n = n;
+}
+
+// estimate and standard error of a measure item
+void estimateItem(const STATS *s, int item, double *mean, double *se)
+{
+	double r, var;
+
+	if(item == ITEM_IN_GAME){
+		r = (s->mean[VALUE_GAMES] > 0.0) ? s->mean[ITEM_IN_GAME] / s->mean[VALUE_GAMES] : 0.0;
+		var = s->m2[ITEM_IN_GAME] - 2.0 * r * s->c2g + r * r * s->m2[VALUE_GAMES];
+		*mean = r;
+		*se = (s->n > 1 && s->mean[VALUE_GAMES] > 0.0) ? sqrt(fmax(var, 0.0) / (s->n - 1) / s->n) / s->mean[VALUE_GAMES] : 0.0;
+	} else {
+		*mean = s->mean[item];
+		*se = (s->n > 1) ? sqrt(s->m2[item] / (s->n - 1) / s->n) : 0.0;
+	}
+}
+
+double standardError(const STATS *s, int item)
+{
+	double mean, se;
+
+	estimateItem(s, item, &mean, &se);
+	return se;
+}
+
+// replicates in total for the confidence intervals of items[0],..., items[nItems-1] to reach the precision, at least s->n
+long repsNeeded(const STATS *s, double precision, const int items[], int nItems)
+{
+	int i;
+	double mean, se, halfWidth, ratio;
+	long need = s->n;
+
+	for(i=0; i<nItems; i++){
+		estimateItem(s, items[i], &mean, &se);
+		halfWidth = CONFIDENCE_Z * se;
+		if(halfWidth <= precision * fabs(mean)) continue;
+		if(mean == 0.0) return LONG_MAX; // only the cap stops it
+		ratio = halfWidth / (precision * fabs(mean));
+		if(ratio * ratio * s->n > (double)need) need = (ratio * ratio * s->n < (double)LONG_MAX / 2) ? (long)ceil(ratio * ratio * s->n) : LONG_MAX / 2;
+	}
+	return need;
+}
+
+#endif
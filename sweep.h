@@ -0,0 +1,456 @@
+/*
+   Runs of many parameter points without recompiling (-s spec).
+
+   A spec file has one swept parameter per line, with its values as a list
+   or as a range first:step:last (first:last steps by 1),
+
+     # R_0 x sensitivity x read time
+     R_0 = 2.5, 3.5, 5
+     PCR_I = 0.6:0.1:0.9
+     REG_READ_TIME = 1:3
+
+   and the points are the Cartesian product of the lines, the last line
+   varying fastest. The names are MEMBER (up to MAX_MEMBER), R_0, ONE_T or DELTA (one sets the other),
+   REG_READ_TIME (regular PCR tests of regularTesting only, up to DUE_DAYS), weeks, latent,
+   eta, game (see league.h), tau_error (see tauEngine.h), reps, precision (see stats.h), PCR_P1, PCR_P2, PCR_I, and antigen or antigen0, antigen1,...
+   for one scenario. eta and the sensitivities are probabilities, from 0
+   to 1, R_0 is not negative, and a point with a value out of range stops
+   the run. Parameters not in the spec keep the defaults of the program. The (point, scenario, chunk) tasks of all points share one
+   dynamically scheduled loop, and the rows of a point are written as soon
+   as its last chunk is done, so the rows may come out of point order.
+   With a precision the chunks run in rounds, the next round of a point
+   is set when its last round is done (see stats.h). In lockstep (-l) a
+   task runs chunk k of all scenarios of a point at once, and the
+   scenarios of a point go through the same rounds.
+   Every point uses the same random numbers for the same (scenario,
+   replicate), the differences between points are not blurred by noise.
+*/
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "model.h"
+#include "variance.h"
+#include "checkpoint.h"
+
+#define MAX_AXES 16 // swept parameters in a spec
+#define MAX_VALUES 1024 // values of one parameter
+
+typedef struct axis {
+	char key[32];
+	int n;
+	double value[MAX_VALUES];
+} AXIS;
+
+typedef struct sweep {
+	int nAxes;
+	AXIS axis[MAX_AXES];
+	long nPoints;
+} SWEEP;
+
+// called once the totals of all scenarios of a point are known
+typedef void (*REPORTFUNC)(void *context, long point, const PARAMS *par, RESULT total[]);
+
+static inline int isProbability(double value)
+{
+	return value >= 0.0 && value <= 1.0;
+}
+
+// set one parameter by its name in the spec, returns -1 for an unknown name or a bad value
+int setParam(PARAMS *p, const char *key, double value)
+{
+	int scenario;
+	char *end;
+
+	if(strcmp(key, "MEMBER") == 0){
+		if(value < 1.0 || value > MAX_MEMBER) return -1;
+		p->member = (int)value;
+	} else if(strcmp(key, "R_0") == 0){
+		if(value < 0.0) return -1;
+		p->R0 = value;
+	} else if(strcmp(key, "ONE_T") == 0){ // keeps a day 1 long
+		if(value < 1.0) return -1;
+		p->oneT = (int)value;
+		p->delta = 1.0 / (double)p->oneT;
+	} else if(strcmp(key, "DELTA") == 0){
+		if(value <= 0.0 || value > 1.0) return -1;
+		p->oneT = (int)(1.0 / value + 0.5);
+		p->delta = 1.0 / (double)p->oneT;
+	} else if(strcmp(key, "REG_READ_TIME") == 0){
+		if(value < 1.0 || value > DUE_DAYS) return -1;
+		p->readTime = (int)value;
+	} else if(strcmp(key, "weeks") == 0){
+		if(value < 1.0) return -1;
+		p->weeks = (int)value;
+	} else if(strcmp(key, "latent") == 0){
+		if(value <= 0.0) return -1;
+		p->latent = value;
+	} else if(strcmp(key, "eta") == 0){
+		if(!isProbability(value)) return -1;
+		p->eta = value;
+	} else if(strcmp(key, "game") == 0){
+		if(value < 0.0) return -1;
+		p->game = value;
+	} else if(strcmp(key, "tau_error") == 0){
+		if(value < 0.0) return -1;
+		p->tauError = value;
+	} else if(strcmp(key, "reps") == 0){
+		if(value < 1.0) return -1;
+		p->reps = (int)value;
+	} else if(strcmp(key, "precision") == 0){
+		if(value < 0.0) return -1;
+		p->precision = value;
+	} else if(strncmp(key, "PCR_", 4) == 0 || strncmp(key, "antigen", 7) == 0){ // sensitivities, probabilities
+		if(!isProbability(value)) return -1;
+		if(strcmp(key, "PCR_P1") == 0) p->PCRSTV[2] = value;
+		else if(strcmp(key, "PCR_P2") == 0) p->PCRSTV[3] = value;
+		else if(strcmp(key, "PCR_I") == 0) p->PCRSTV[4] = p->PCRSTV[5] = value; // Is and Ia
+		else if(strcmp(key, "antigen") == 0) for(scenario=0; scenario<MAX_SCENARIOS; scenario++) p->antigen[scenario] = value;
+		else if(strncmp(key, "antigen", 7) == 0 && key[7] >= '0' && key[7] <= '9'){ // antigen0, antigen1,...
+			scenario = (int)strtol(key + 7, &end, 10);
+			if(*end != '\0' || scenario >= MAX_SCENARIOS) return -1;
+			p->antigen[scenario] = value;
+		} else return -1;
+	} else return -1;
+	return 0;
+}
+
+// parse the values of one line of a spec, returns -1 on a syntax error
+int readAxisValues(AXIS *a, char *text)
+{
+	char *item, *end;
+	double first, step, last, x;
+	int k;
+
+	a->n = 0;
+	for(item = strtok(text, ","); item != NULL; item = strtok(NULL, ",")){
+		first = strtod(item, &end);
+		if(end == item) return -1;
+		while(*end == ' ' || *end == '\t') end++;
+		if(*end == ':'){ // a range
+			step = 1.0;
+			last = strtod(end + 1, &end);
+			while(*end == ' ' || *end == '\t') end++;
+			if(*end == ':'){ // first:step:last
+				step = last;
+				last = strtod(end + 1, &end);
+			}
+			if(step == 0.0 || (last - first) / step < 0.0) return -1;
+			for(k=0; ; k++){
+				x = first + k * step; // no accumulated rounding
+				if((step > 0.0) ? (x > last + 1e-9 * step) : (x < last + 1e-9 * step)) break;
+				if(a->n == MAX_VALUES) return -1;
+				a->value[a->n++] = x;
+			}
+		} else {
+			if(a->n == MAX_VALUES) return -1;
+			a->value[a->n++] = first;
+		}
+		while(*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n') end++;
+		if(*end != '\0') return -1;
+	}
+	return (a->n > 0) ? 0 : -1;
+}
+
+// read a spec file, returns -1 and prints the reason on an error
+int readSweep(const char *fileName, SWEEP *sw)
+{
+	FILE *fp;
+	char line[4096], *eq, *key, *end;
+	int lineNumber = 0;
+	PARAMS test = {0};
+
+	fp = fopen(fileName, "r");
+	if(fp == NULL){
+		fprintf(stderr, "%s: cannot open\n", fileName);
+		return -1;
+	}
+	sw->nAxes = 0;
+	sw->nPoints = 1;
+	while(fgets(line, sizeof(line), fp) != NULL){
+		lineNumber++;
+		if((end = strchr(line, '#')) != NULL) *end = '\0';
+		for(key = line; *key == ' ' || *key == '\t'; key++);
+		if(*key == '\0' || *key == '\n' || *key == '\r') continue; // blank line
+
+		eq = strchr(key, '=');
+		if(eq == NULL || sw->nAxes == MAX_AXES) goto bad;
+		for(end = eq; end > key && (end[-1] == ' ' || end[-1] == '\t'); end--);
+		*end = '\0';
+		if(end - key >= (int)sizeof(sw->axis[0].key)) goto bad;
+		strcpy(sw->axis[sw->nAxes].key, key);
+		if(setParam(&test, key, 1.0) < 0){
+			fprintf(stderr, "%s:%d: unknown parameter %s\n", fileName, lineNumber, key);
+			fclose(fp);
+			return -1;
+		}
+		if(readAxisValues(&sw->axis[sw->nAxes], eq + 1) < 0) goto bad;
+		sw->nPoints *= sw->axis[sw->nAxes].n;
+		sw->nAxes++;
+	}
+	fclose(fp);
+	return 0;
+
+  bad:
+	fprintf(stderr, "%s:%d: expected name = value, value,... or name = first:step:last\n", fileName, lineNumber);
+	fclose(fp);
+	return -1;
+}
+
+// the parameters of a point, base with the swept parameters set, returns -1 for a bad value
+int sweepPoint(const SWEEP *sw, long point, const PARAMS *base, PARAMS *p)
+{
+	int a;
+
+	*p = *base;
+	for(a=sw->nAxes-1; a>=0; a--){
+		if(setParam(p, sw->axis[a].key, sw->axis[a].value[point % sw->axis[a].n]) < 0){
+			fprintf(stderr, "bad value %g for %s\n", sw->axis[a].value[point % sw->axis[a].n], sw->axis[a].key);
+			return -1;
+		}
+		point /= sw->axis[a].n;
+	}
+	deriveParams(p);
+	return 0;
+}
+
+// chunks of replicates of one scenario
+static inline int chunksOf(const PARAMS *p, int scenario)
+{
+	return (repsOf(p, scenario) + REPS_PER_CHUNK - 1) / REPS_PER_CHUNK;
+}
+
+// the first chunk of a scenario among the chunks of its point, the scenarios follow each other
+static inline int chunkOffset(const PARAMS *p, int scenario)
+{
+	int s, offset = 0;
+
+	for(s=0; s<scenario; s++) offset += chunksOf(p, s);
+	return offset;
+}
+
+// number of MT streams for runPoints(), one per (scenario, chunk) of the longest point,
+// or one per chunk when the scenarios share their random numbers
+int streamsFor(const PARAMS par[], long nPoints)
+{
+	long point;
+	int s, chunks = 1;
+
+	for(point=0; point<nPoints; point++)
+		for(s=0; s<nScenarios; s++) if(chunksOf(&par[point], s) > chunks) chunks = chunksOf(&par[point], s);
+	return commonNumbers ? chunks : nScenarios * chunks;
+}
+
+// the chunk before which the next round of a scenario stops, done when the scenario is over;
+// without a precision all the chunks run in one round
+static int roundEnd(const PARAMS *p, int scenario, const RESULT *total, int done)
+{
+	int chunks = chunksOf(p, scenario);
+	long need, end;
+
+	if(p->precision <= 0.0) return chunks;
+	if(done == 0) need = MIN_REPS;
+	else {
+		need = repsNeeded(&total->stat, p->precision, reportItems, (int)(sizeof(reportItems)/sizeof(reportItems[0]))); // the items printed
+		if(need == total->stat.n) return done; // precise enough
+	}
+	end = need / REPS_PER_CHUNK + (need % REPS_PER_CHUNK != 0);
+	if(end <= done) end = done + 1;
+	return (end < chunks) ? (int)end : chunks;
+}
+
+// run all scenarios of every point and report each point when it is done,
+// chunk k of scenario s runs on streams[s*maxChunks + k] (streams[k] with commonNumbers) for every point;
+// with checkpoints (see checkpoint.h) the chunks done before are not run again, a shard runs its
+// chunks and reports nothing; returns -1 if a checkpoint or shard is not of this run
+int runPoints(const PARAMS par[], long nPoints, int engine, CHUNKFUNC runChunk, MT64 streams[], REPORTFUNC report, void *context)
+{
+	long point, task, nTasks, nTodo, *first, *todo;
+	int *left, *next, *until, maxChunks, s, k, ok = 1;
+	unsigned long long fingerprint;
+	unsigned char *chunkDone;
+	RESULT *chunkTotal, *total;
+
+	maxChunks = commonNumbers ? streamsFor(par, nPoints) : streamsFor(par, nPoints) / nScenarios;
+	first = malloc((nPoints + 1) * sizeof(long));
+	left = malloc(nPoints * sizeof(int));
+	next = malloc(nPoints * nScenarios * sizeof(int));
+	until = malloc(nPoints * nScenarios * sizeof(int));
+	total = malloc(nPoints * nScenarios * sizeof(RESULT));
+	first[0] = 0;
+	for(point=0; point<nPoints; point++){
+		first[point+1] = first[point] + chunkOffset(&par[point], nScenarios);
+		for(s=0; s<nScenarios; s++){
+			clearResult(&total[point*nScenarios + s]);
+			next[point*nScenarios + s] = 0;
+			until[point*nScenarios + s] = roundEnd(&par[point], s, &total[point*nScenarios + s], 0);
+		}
+	}
+	nTasks = first[nPoints];
+	chunkTotal = malloc(nTasks * sizeof(RESULT));
+	todo = malloc(nTasks * sizeof(long));
+	chunkDone = calloc(nTasks, 1);
+	fingerprint = runFingerprint(par, nPoints, engine);
+	if(checkpointName != NULL && loadCheckpoint(checkpointName, 0, fingerprint, nTasks, chunkDone, chunkTotal) < 0) ok = 0;
+	if(nMerge > 0 && mergeShards(fingerprint, nTasks, chunkDone, chunkTotal) < 0) ok = 0;
+
+	// chunks next,..., until-1 of every scenario in a round, a single round without a precision
+	while(ok){
+		nTodo = 0;
+		for(point=0; point<nPoints; point++){
+			left[point] = 0;
+			for(s=0; s<(lockstep ? 1 : nScenarios); s++){
+				for(k=next[point*nScenarios + s]; k<until[point*nScenarios + s]; k++){
+					todo[nTodo] = first[point] + chunkOffset(&par[point], s) + k;
+					if(todo[nTodo] % shardCount != shardIndex) continue; // of another shard
+					nTodo++;
+					left[point]++;
+				}
+			}
+		}
+		if(nTodo == 0) break;
+
+		// tasks in point order, the point of a task is found by bisection
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic)
+#endif
+		for(task = 0; task<nTodo; task++){
+			long lo = 0, hi = nPoints - 1, mid, chunk = todo[task];
+			int chunks, s, k, n, c, done, over;
+			MT64 stream;
+			RESULT *t = &chunkTotal[chunk], *sum, forked[MAX_SCENARIOS];
+
+			while(lo < hi){
+				mid = (lo + hi + 1) / 2;
+				if(first[mid] <= chunk) lo = mid;
+				else hi = mid - 1;
+			}
+			for(s=0; s<nScenarios-1 && chunk - first[lo] >= chunkOffset(&par[lo], s+1); s++);
+			chunks = chunksOf(&par[lo], s);
+			k = (int)(chunk - first[lo] - chunkOffset(&par[lo], s));
+			n = (k == chunks-1) ? repsOf(&par[lo], s) - k*REPS_PER_CHUNK : REPS_PER_CHUNK;
+
+			if(!chunkDone[chunk]){ // not in the checkpoint
+				if(rngMode == RNG_MT){
+					stream = *randomStream(streams, commonNumbers ? k : s*maxChunks + k);
+					currentStream = &stream;
+				}
+				clearResult(t);
+				if(lockstep){ // chunk k of every scenario
+					for(c=0; c<nScenarios; c++) clearResult(&forked[c]);
+					runChunk(ALL_SCENARIOS, engine, k*REPS_PER_CHUNK, n, &par[lo], forked);
+					for(c=0; c<nScenarios; c++) chunkTotal[first[lo] + chunkOffset(&par[lo], c) + k] = forked[c];
+				} else if(varianceMode) runReducedChunk(runChunk, s, engine, k*REPS_PER_CHUNK, n, &par[lo], t);
+				else runChunk(s, engine, k*REPS_PER_CHUNK, n, &par[lo], t);
+				PROFILE_FLUSH();
+#ifdef _OPENMP
+				#pragma omp flush
+#endif
+				for(c=0; c<(lockstep ? nScenarios : 1); c++){
+#ifdef _OPENMP
+					#pragma omp atomic write
+#endif
+					chunkDone[lockstep ? first[lo] + chunkOffset(&par[lo], c) + k : chunk] = 1;
+				}
+				saveCheckpoint(fingerprint, nTasks, chunkDone, chunkTotal, 0);
+			}
+
+#ifdef _OPENMP
+			#pragma omp atomic capture
+#endif
+			done = --left[lo];
+			if(done == 0 && shardCount == 1){ // the last chunk of the point in this round, add the chunks in order
+				over = 1;
+				for(s=0; s<nScenarios; s++){
+					sum = &total[lo*nScenarios + s];
+					for(c=next[lo*nScenarios + s]; c<until[lo*nScenarios + s]; c++) addResult(sum, &chunkTotal[first[lo] + chunkOffset(&par[lo], s) + c]);
+					next[lo*nScenarios + s] = until[lo*nScenarios + s];
+					until[lo*nScenarios + s] = roundEnd(&par[lo], s, sum, next[lo*nScenarios + s]);
+					if(until[lo*nScenarios + s] > next[lo*nScenarios + s]) over = 0;
+				}
+				if(lockstep) for(s=1; s<nScenarios; s++) // the round of the least precise scenario
+					if(until[lo*nScenarios + s] > until[lo*nScenarios]) until[lo*nScenarios] = until[lo*nScenarios + s];
+				if(over){
+#ifdef _OPENMP
+					#pragma omp critical(report)
+#endif
+					report(context, lo, &par[lo], &total[lo*nScenarios]);
+				}
+			}
+		}
+		if(shardCount > 1) break; // the merge adds the chunks
+	}
+
+	if(ok) endCheckpoints(fingerprint, nTasks, chunkDone, chunkTotal);
+	free(chunkDone);
+	free(todo);
+	free(chunkTotal);
+	free(total);
+	free(until);
+	free(next);
+	free(left);
+	free(first);
+	return ok ? 0 : -1;
+}
+
+// what writeSweepRows() needs besides the point
+typedef struct csvOut {
+	FILE *fp;
+	const SWEEP *sw;
+} CSVOUT;
+
+void writeSweepHeader(CSVOUT *out)
+{
+	static const char *name[ITEMS] = {"final_size", "cease_day", "infected_in_game", "mass_infection"};
+	int a, item;
+
+	fprintf(out->fp, "point");
+	for(a=0; a<out->sw->nAxes; a++) fprintf(out->fp, ",%s", out->sw->axis[a].key);
+	fprintf(out->fp, ",scenario,replicates,final_size,final_size_se,cease_day,cease_day_se,infected_in_game,infected_in_game_se,mass_infection,mass_infection_se");
+	if(varianceMode) for(item=0; item<ITEMS; item++){ // the variance-reduced estimates, see variance.h
+		if(item == ITEM_IN_GAME) continue;
+		fprintf(out->fp, ",%s_vr,%s_vr_se,%s_vrf,%s_delta,%s_delta_se,%s_delta_vrf", name[item], name[item], name[item], name[item], name[item], name[item]);
+	}
+	fprintf(out->fp, "\n");
+	fflush(out->fp);
+}
+
+// the point and the values of its swept parameters, the first columns of a row
+void writeSweepPoint(FILE *fp, const SWEEP *sw, long point)
+{
+	int a, b;
+	long rest, stride;
+
+	fprintf(fp, "%ld", point);
+	for(a=0, rest=point; a<sw->nAxes; a++){
+		for(stride=1, b=a+1; b<sw->nAxes; b++) stride *= sw->axis[b].n;
+		fprintf(fp, ",%g", sw->axis[a].value[rest / stride]);
+		rest %= stride;
+	}
+}
+
+// one CSV row per scenario, a REPORTFUNC
+void writeSweepRows(void *context, long point, const PARAMS *par, RESULT total[])
+{
+	CSVOUT *out = context;
+	int s, item, i;
+	double mean[ITEMS], reduced[6];
+
+	(void)par; // the values of the point are those of its axes
+
+	for(s=0; s<nScenarios; s++){
+		writeSweepPoint(out->fp, out->sw, point);
+		fprintf(out->fp, ",%d,%ld", s, total[s].stat.n);
+		itemMeans(&total[s], mean);
+		for(item=0; item<ITEMS; item++) fprintf(out->fp, ",%g,%g", mean[item], standardError(&total[s].stat, item));
+		if(varianceMode) for(item=0; item<ITEMS; item++){
+			if(item == ITEM_IN_GAME) continue;
+			reducedEstimate(total, s, item, reduced);
+			for(i=0; i<6; i++) fprintf(out->fp, ",%g", reduced[i]);
+		}
+		fprintf(out->fp, "\n");
+	}
+	fflush(out->fp);
+}
+
+#endif
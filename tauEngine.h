@@ -0,0 +1,182 @@
+/*
+   Adaptive tau-leaping for the infection process within a day (-e tau).
+
+   The continuous-time model of the gillespie engine, advanced by leaps
+   in which every transition fires a Poisson number of times at the
+   propensities of the start of the leap. The leap is chosen from the
+   propensities by the rule of Cao, Gillespie and Petzold (2006): as long
+   as possible while the expected change and the standard deviation of the
+   number of members in every state, and of the infectious members who are
+   not isolated, stay within a fraction tau_error of the number (of half
+   of it for S and the infectious members, which meet in the second order
+   infection). A quiet day is one leap, a peak many short ones, and
+   tau_error trades accuracy for speed: 0 runs the exact events of the
+   gillespie engine and never leaps.
+
+   Transitions out of a state with fewer than TAU_CRITICAL members are
+   critical (Cao, Gillespie and Petzold 2005): they do not leap, one of
+   them fires at an exponential time of their total propensity if that
+   comes before the end of the leap. A leap that would take more members
+   out of a state than it has is halved and drawn again, and a leap
+   shorter than TAU_EXACT mean times between events is not worth it, the
+   day goes on by TAU_EXACT_EVENTS exact events instead. Every leap stops
+   at the end of the day, so the daily symptom check and the tests see
+   the state of the end of the day as with the other engines. The members
+   that move are drawn at random from the cohorts of their state, which
+   are assigned at the end of the day as in the binomial engine.
+
+   A day of a team of up to MAX_MEMBER members has a few tens of events,
+   few of them in states that are large compared with 1/tau_error, so
+   most days run exact and tau costs about what gillespie does; the leaps
+   pay off with a large tau_error or at the peak of a large population.
+*/
+
+#ifndef TAUENGINE_H
+#define TAUENGINE_H
+
+#include "gillespieEngine.h"
+
+#define TAU_CRITICAL 10 // transitions out of a state with fewer members fire one at a time
+#define TAU_EXACT 10.0 // leaps shorter than this many mean times between events run exact events instead
+#define TAU_EXACT_EVENTS 100 // exact events before a leap is tried again
+
+// a Poisson variate of the given mean
+int poisson(double mean)
+{
+	int k;
+	double u, f;
+
+	if(mean <= 0.0) return 0;
+	if(mean > 30.0) return poisson(mean / 2.0) + poisson(mean - mean / 2.0); // keep exp(-mean) away from underflow
+
+	// inversion, walk up the cumulative distribution from k = 0
+	f = exp(-mean);
+	u = urand();
+	for(k=0; u > f && f > 0.0; k++){
+		u -= f;
+		f *= mean / (double)(k + 1);
+	}
+	return k;
+}
+
+// the longest leap over which the number of members in a state, and of the infectious members who are not
+// isolated, changes by a fraction eps in mean and standard deviation, from the transitions that are not
+// critical; HUGE_VAL when they cannot change
+static double leapSize(const double propensity[], const int critical[], const int number[], const int stateNumber[], double eta, double eps)
+{
+	int i;
+	double a[6], mu[7], var[7], x[7], g[7], share4, share5, bound, tau = HUGE_VAL;
+
+	for(i=0; i<6; i++){
+		a[i] = critical[i] ? 0.0 : propensity[i];
+		x[i] = number[i];
+		g[i] = 1.0;
+	}
+	g[0] = 2.0; // S is infected by the infectious members, second order
+
+	// the change per day of the members in S, E, P1, P2, Is and Ia
+	mu[0] = -a[0];
+	var[0] = a[0];
+	mu[1] = a[0] - a[1];
+	var[1] = a[0] + a[1];
+	mu[2] = a[1] - a[2];
+	var[2] = a[1] + a[2];
+	mu[3] = a[2] - a[3];
+	var[3] = a[2] + a[3];
+	mu[4] = eta * a[3] - a[4];
+	var[4] = eta * a[3] + a[4];
+	mu[5] = (1.0 - eta) * a[3] - a[5];
+	var[5] = (1.0 - eta) * a[3] + a[5];
+
+	// the infectious members who are not isolated, in from E, out of Is and Ia that are not isolated
+	share4 = (number[4] > 0) ? (double)stateNumber[4] / number[4] : 0.0;
+	share5 = (number[5] > 0) ? (double)stateNumber[5] / number[5] : 0.0;
+	x[6] = stateNumber[2] + stateNumber[3] + stateNumber[4] + stateNumber[5];
+	g[6] = 2.0;
+	mu[6] = a[1] - share4 * a[4] - share5 * a[5];
+	var[6] = a[1] + share4 * a[4] + share5 * a[5];
+
+	for(i=0; i<7; i++){
+		bound = eps * x[i] / g[i];
+		if(bound < 1.0) bound = 1.0;
+		if(mu[i] != 0.0 && bound / fabs(mu[i]) < tau) tau = bound / fabs(mu[i]);
+		if(var[i] > 0.0 && bound * bound / var[i] < tau) tau = bound * bound / var[i];
+	}
+	return tau;
+}
+
+void infections_in_a_day_tau(int stateNumber[], INDIV *indiv, const PARAMS *par)
+{
+	int q, a, s, j, next, events, fire, k4, k[6], critical[6], number[STATES];
+	double t, tau, tauLeap, tauCritical, total, totalCritical, u, rate[STATES], propensity[6];
+	COHORTS c;
+
+	if(par->tauError <= 0.0){ // no leap is short enough, the exact process
+		infections_in_a_day_gillespie(stateNumber, indiv, par);
+		return;
+	}
+	beginCohorts(&c, indiv, par->member);
+
+	// members in each state, quarantined or not, quarantined ones keep progressing
+	for(s=0; s<STATES; s++) number[s] = c.size[0][s] + c.size[1][s];
+	gillespieRates(rate, par);
+
+	for(t=0.0; t<1.0; ){
+		propensity[0] = rate[0] * (double)number[0] * (double)(stateNumber[2] + stateNumber[3] + stateNumber[4] + stateNumber[5]);
+		total = propensity[0];
+		for(s=1; s<6; s++){
+			propensity[s] = rate[s] * (double)number[s];
+			total += propensity[s];
+		}
+		if(total <= 0.0) break;
+
+		// the critical transitions, out of states with few members
+		totalCritical = 0.0;
+		for(s=0; s<6; s++){
+			critical[s] = (propensity[s] > 0.0 && number[s] < TAU_CRITICAL);
+			if(critical[s]) totalCritical += propensity[s];
+		}
+
+		tauLeap = leapSize(propensity, critical, number, stateNumber, par->eta, par->tauError);
+		if(tauLeap < TAU_EXACT / total){ // too short to leap, exact events
+			for(events=0; events<TAU_EXACT_EVENTS && t<1.0; events++) t = gillespieEvent(&c, number, stateNumber, rate, par, t);
+			continue;
+		}
+		tauCritical = (totalCritical > 0.0) ? -log(urand()) / totalCritical : HUGE_VAL;
+
+		// draw the leap, shorter until no state runs out of members
+		for(;;){
+			fire = (tauCritical <= tauLeap && tauCritical < 1.0 - t); // a critical transition ends the leap
+			tau = fire ? tauCritical : (tauLeap < 1.0 - t) ? tauLeap : 1.0 - t; // land on the end of the day
+			for(s=0; s<6; s++) k[s] = critical[s] ? 0 : poisson(propensity[s] * tau);
+			if(fire){
+				u = urand() * totalCritical;
+				for(s=0; s<6; s++){
+					if(!critical[s]) continue;
+					if(u < propensity[s]) break;
+					u -= propensity[s];
+				}
+				if(s == 6) for(s=5; !critical[s]; s--); // rounding at the upper end
+				k[s] = 1;
+			}
+			for(s=0; s<6 && k[s] <= number[s]; s++);
+			if(s == 6) break;
+			tauLeap /= 2.0;
+		}
+
+		// the members that move, from the later states down so that a member moves at most once in a leap
+		k4 = binomial(k[3], par->eta); // P2 individuals will be either Is or Ia
+		for(s=5; s>=0; s--){
+			for(j=0; j<k[s]; j++){
+				pickCohort(&c, s, urand() * (double)number[s], &q, &a);
+				next = (s == 3) ? ((j < k4) ? 4 : 5) : (s < 4) ? s + 1 : 6;
+				moveCohort(&c, q, a, s, next, number, stateNumber);
+			}
+		}
+		t += tau;
+	}
+
+	assignCohorts(&c, indiv);
+}
+
+#endif
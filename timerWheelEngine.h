@@ -0,0 +1,118 @@
+/*
+   Pre-sampled sojourn times for the infection process within a day
+   (-e wheel).
+
+   Leaving E, P1, P2, Is or Ia has a constant probability per ONE_T step,
+   so the number of steps spent in the state is geometric. It is drawn
+   once when a member enters the state, and the member waits in a timer
+   wheel bucketed by step. Only the members whose timer fires are touched,
+   and only susceptible members need a draw every step. The timers persist
+   from day to day, so startTimerWheel() must be called for every new
+   replicate.
+*/
+
+#ifndef TIMERWHEELENGINE_H
+#define TIMERWHEELENGINE_H
+
+#include "model.h"
+
+#define WHEEL_SIZE 1024 // buckets, a power of 2; later timers wait for another lap
+
+typedef struct timerWheel {
+	int started; // 0: the timers of the replicate are not set yet
+	long long clock; // ONE_T steps since the start of the replicate
+	long long fireTime[MAX_MEMBER]; // step at which the member leaves its state
+	int next[MAX_MEMBER]; // next member in the same bucket, -1 at the end
+	int head[WHEEL_SIZE]; // first member in each bucket, -1 if empty
+	int susceptible[MAX_MEMBER], nSusceptible; // S members, the only ones drawn every step
+} TIMERWHEEL;
+
+static _Thread_local TIMERWHEEL wheel;
+
+// forget the timers of the previous replicate
+void startTimerWheel()
+{
+	wheel.started = 0;
+}
+
+// number of steps until leaving a state left with probability p per step, 1 or more
+static inline long long sojourn(double logStay)
+{
+	return 1 + (long long)(log(urand()) / logStay);
+}
+
+static inline void scheduleMember(int member, long long fireTime)
+{
+	int b = (int)(fireTime & (WHEEL_SIZE - 1));
+
+	wheel.fireTime[member] = fireTime;
+	wheel.next[member] = wheel.head[b];
+	wheel.head[b] = member;
+}
+
+void infections_in_a_day_wheel(int stateNumber[], INDIV *indiv, const PARAMS *par)
+{
+	int t, i, member, state, next, b, due;
+	double force_infection, logStay[STATES];
+
+	logStay[1] = log1p(-par->sigma); // E -> P1
+	logStay[2] = log1p(-par->rho); // P1 -> P2
+	logStay[3] = log1p(-par->rho); // P2 -> Is or Ia
+	logStay[4] = log1p(-par->gamma); // Is -> R
+	logStay[5] = log1p(-par->gamma); // Ia -> R
+
+	if(!wheel.started){
+		wheel.clock = 0;
+		wheel.nSusceptible = 0;
+		for(b=0; b<WHEEL_SIZE; b++) wheel.head[b] = -1;
+		for(member=0; member<par->member; member++){
+			state = indiv->state[member];
+			if(state == 0) wheel.susceptible[wheel.nSusceptible++] = member;
+			else if(state < 6) scheduleMember(member, sojourn(logStay[state]) - 1);
+		}
+		wheel.started = 1;
+	}
+
+	for(t=0; t<par->oneT; t++, wheel.clock++){
+		force_infection = par->beta*(double)(stateNumber[2] + stateNumber[3] + stateNumber[4] + stateNumber[5]);
+
+		// timers firing in this step, members scheduled for a later lap stay in the bucket
+		b = (int)(wheel.clock & (WHEEL_SIZE - 1));
+		due = wheel.head[b];
+		wheel.head[b] = -1;
+		while(due >= 0){
+			member = due;
+			due = wheel.next[member];
+			if(wheel.fireTime[member] != wheel.clock){
+				scheduleMember(member, wheel.fireTime[member]);
+				continue;
+			}
+			state = indiv->state[member];
+			if(state == 3) next = (urand() < par->eta) ? 4 : 5; // P2 individuals will be either Is or Ia
+			else next = (state < 4) ? state + 1 : 6;
+			moveMember(indiv, member, next);
+			// change the stateNumber only when this individual is not quarantined
+			if(!testBit(indiv->quarantine, member)){
+				stateNumber[state]--;
+				stateNumber[next]++;
+			}
+			if(next < 6) scheduleMember(member, wheel.clock + sojourn(logStay[next]));
+		}
+
+		// infections, a member infected in this step leaves E in a later step
+		if(force_infection > 0.0){
+			for(i=0; i<wheel.nSusceptible; i++){
+				member = wheel.susceptible[i];
+				if(urand() < force_infection){
+					moveMember(indiv, member, 1);
+					stateNumber[0]--;
+					stateNumber[1]++;
+					scheduleMember(member, wheel.clock + sojourn(logStay[1]));
+					wheel.susceptible[i--] = wheel.susceptible[--wheel.nSusceptible];
+				}
+			}
+		}
+	} // one_t
+}
+
+#endif
@@ -0,0 +1,6 @@
+# training runs of the profile-guided builds (make pgo), a few replicates
+# at the specialized team sizes and at two R_0 so that every kernel copy
+# and both outbreak regimes are in the profile
+MEMBER = 16, 50, 128
+R_0 = 2.5, 5
+reps = 20
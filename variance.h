@@ -0,0 +1,157 @@
+/*
+   Variance-reduced estimation of the scenarios and of their differences
+   from scenario 0 (-v antithetic|control|both).
+
+   antithetic: the replicates run in pairs, the second replicate of a pair
+   draws 1-u wherever the first draws u, and the samples are the means of
+   the pairs. Outcomes that grow with the draws are negatively correlated
+   within a pair.
+
+   control: replicate r of every scenario draws the same random numbers
+   (commonNumbers), and every replicate of scenario k > 0 is run again as
+   scenario 0, its twin. Scenario 0 itself runs BASELINE_REPS times as many
+   replicates as the others, which gives its mean mu0 precisely, and the
+   estimate of scenario k is corrected with the twins as a control variate,
+     y - c (b - mu0),  c = cov(y, b) / var(b),
+   where y and b are the means of the scenario and of its twins. The twins
+   are the first replicates of scenario 0, so the variance is
+   var(y) (1 - rho^2 (1 - n/N)) for n samples and N samples of scenario 0.
+   The difference from scenario 0 is the corrected estimate minus mu0.
+
+   The report gives, for the items that are means of replicates, the
+   estimate, its standard error and the variance-reduction factor, the
+   variance of plain Monte Carlo with the same replicates over the variance
+   achieved, and the same three for the difference from scenario 0, where
+   plain Monte Carlo runs the two scenarios independently. Infected in
+   game, a ratio of totals, is left out. The twins cost replicates too,
+   they are not counted in the factor.
+*/
+
+#ifndef VARIANCE_H
+#define VARIANCE_H
+
+#include "model.h"
+
+#ifndef BASELINE_REPS
+#define BASELINE_REPS 4 // replicates of scenario 0 per replicate of the others with VR_CONTROL
+#endif
+
+// runs replicates firstRep,..., firstRep+nReps-1 of a scenario and adds their measure items to total
+typedef void (*CHUNKFUNC)(int scenario, int engine, int firstRep, int nReps, const PARAMS *par, RESULT *total);
+
+// variance reduction from its name on the command line, -1 if unknown
+int varianceByName(const char *name)
+{
+	if(strcmp(name, "antithetic") == 0) return VR_ANTITHETIC;
+	if(strcmp(name, "control") == 0) return VR_CONTROL;
+	if(strcmp(name, "both") == 0) return VR_ANTITHETIC | VR_CONTROL;
+	return -1;
+}
+
+// replicates of a scenario at a point
+static inline int repsOf(const PARAMS *p, int scenario)
+{
+	return ((varianceMode & VR_CONTROL) && scenario == 0) ? BASELINE_REPS * p->reps : p->reps;
+}
+
+// the values of the single replicate in one
+static void replicateValues(const RESULT *one, double x[VALUES])
+{
+	x[0] = one->numInfects;
+	x[1] = one->dayInfectionCease;
+	x[2] = one->infectedInGame;
+	x[3] = one->massInfection;
+	x[VALUE_GAMES] = one->gameCount;
+}
+
+// runChunk() one replicate at a time, with antithetic pairs and scenario 0 twins as chosen by -v;
+// both replicates of a pair have the key of the first, and for RNG_MT every replicate starts
+// from the stream where the replicate of scenario 0 starts, so that the twins are the
+// replicates of scenario 0 itself
+void runReducedChunk(CHUNKFUNC runChunk, int scenario, int engine, int firstRep, int nReps, const PARAMS *par, RESULT *total)
+{
+	int i, a, v, runs = (varianceMode & VR_ANTITHETIC) ? 2 : 1;
+	int twin = (varianceMode & VR_CONTROL) && scenario > 0;
+	double x[VALUES], b[VALUES], y[VALUES];
+	RESULT one;
+	MT64 start, end;
+
+	for(i=0; i<nReps; i+=runs){
+		for(v=0; v<VALUES; v++) x[v] = b[v] = 0.0;
+		if(rngMode == RNG_MT) start = *currentStream;
+		for(a=0; a<runs; a++){
+			rngAntithetic(a);
+			if(rngMode == RNG_MT) *currentStream = start;
+			if(twin){
+				clearResult(&one);
+				runChunk(0, engine, firstRep + i, 1, par, &one);
+				replicateValues(&one, y);
+				for(v=0; v<VALUES; v++) b[v] += y[v] / runs;
+				if(rngMode == RNG_MT){
+					end = *currentStream;
+					*currentStream = start;
+				}
+			}
+			clearResult(&one);
+			runChunk(scenario, engine, firstRep + i, 1, par, &one);
+			replicateValues(&one, y);
+			for(v=0; v<VALUES; v++) x[v] += y[v] / runs;
+			addResult(total, &one);
+			if(twin && rngMode == RNG_MT) *currentStream = end;
+		}
+		addPair(&total->pair, x, twin ? b : x);
+	}
+	rngAntithetic(0);
+}
+
+// variance of the mean of value v of plain Monte Carlo with the replicates of total
+static double plainVariance(const RESULT *total, int v)
+{
+	long n = total->stat.n;
+
+	return (n > 1) ? total->stat.m2[v] / (n - 1) / n : 0.0;
+}
+
+// estimate, standard error and variance-reduction factor of value v of scenario s (out[0..2])
+// and of its difference from scenario 0 (out[3..5]), total[] has all scenarios of the point
+void reducedEstimate(const RESULT total[], int s, int v, double out[6])
+{
+	const PAIRSTATS *p = &total[s].pair, *base = &total[0].pair;
+	long n = p->n, bigN = base->n;
+	double mu0, varB0, varY, varB, covYB, c, f, a, var, varDelta, plain, plainDelta;
+
+	mu0 = base->mean[0][v];
+	varB0 = (bigN > 1) ? base->m2[0][v] / (bigN - 1) : 0.0;
+	varY = (n > 1) ? p->m2[0][v] / (n - 1) : 0.0;
+	if(s == 0){
+		out[0] = mu0;
+		var = varB0 / bigN;
+		out[3] = varDelta = 0.0;
+	} else if(varianceMode & VR_CONTROL){
+		varB = (n > 1) ? p->m2[1][v] / (n - 1) : 0.0;
+		covYB = (n > 1) ? p->cross[v] / (n - 1) : 0.0;
+		c = (varB > 0.0) ? covYB / varB : 0.0;
+		f = (double)n / (double)bigN;
+		out[0] = p->mean[0][v] - c * (p->mean[1][v] - mu0);
+		var = (varY - c * covYB * (1.0 - f)) / n;
+		// mu0 mixes the twins with the other N - n samples of scenario 0
+		a = c + (1.0 - c) * f;
+		out[3] = out[0] - mu0;
+		varDelta = (varY - 2.0 * a * covYB + a * a * varB) / n;
+		if(bigN > n) varDelta += (1.0 - c) * (1.0 - c) * (1.0 - f) * (1.0 - f) * varB0 / (bigN - n);
+	} else {
+		out[0] = p->mean[0][v];
+		var = varY / n;
+		out[3] = out[0] - mu0;
+		varDelta = var + varB0 / bigN;
+	}
+
+	plain = plainVariance(&total[s], v);
+	plainDelta = (s == 0) ? 0.0 : plain + plainVariance(&total[0], v);
+	out[1] = sqrt(fmax(var, 0.0));
+	out[2] = (var > 0.0) ? plain / var : 1.0;
+	out[4] = sqrt(fmax(varDelta, 0.0));
+	out[5] = (varDelta > 0.0) ? plainDelta / varDelta : 1.0;
+}
+
+#endif